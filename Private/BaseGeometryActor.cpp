@@ -2,9 +2,18 @@
 
 
 #include "BaseGeometryActor.h"
+#include "GeometryMovementSubsystem.h"
+#include "GeometryMovementKernels.h"
+#include "GeometryMovementModels.h"
+#include "GeometryEventSubsystem.h"
+#include "GeometryLogging.h"
+#include "GeometryStats.h"
+#include "GeometryTimerSubsystem.h"
 #include "Engine/Engine.h"
+#include "Engine/World.h"
 #include "Materials/MaterialInstanceDynamic.h"
 #include "TimerManager.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
 
 #include "WorldPartition/ContentBundle/ContentBundleLog.h"
 
@@ -16,7 +25,31 @@
 // 2. DefaultVerbosity
 // 3. CompileTimeVerbosity
 // DEFINE_LOG_CATEGORY_STATIC(LogBaseGeometry, Error, Error)
-DEFINE_LOG_CATEGORY_STATIC(LogBaseGeometry, All, All)
+// The verbosities come from GeometryLogging.h, so the per-actor diagnostics can be compiled out.
+// Declared there as well, the tests switch the category on and off.
+DEFINE_LOG_CATEGORY(LogBaseGeometry);
+
+DECLARE_CYCLE_STAT(TEXT("Actor Tick"), STAT_GeometryActorTick, STATGROUP_GeometryActors);
+DECLARE_CYCLE_STAT(TEXT("HandleMovement"), STAT_GeometryHandleMovement, STATGROUP_GeometryActors);
+DECLARE_CYCLE_STAT(TEXT("SetColor"), STAT_GeometrySetColor, STATGROUP_GeometryActors);
+DECLARE_CYCLE_STAT(TEXT("OnTimerFired"), STAT_GeometryOnTimerFired, STATGROUP_GeometryActors);
+
+// Material parameters read by the World Position Offset of the GPU movement mode
+static const TCHAR* SinAmplitudeParameterName = TEXT("SinAmplitude");
+static const TCHAR* SinFrequencyParameterName = TEXT("SinFrequency");
+
+// Built on first use like the color parameter of SetColor, instead of an FName lookup per call
+static const FMaterialParameterInfo& GetSinAmplitudeParameterInfo()
+{
+	static const FMaterialParameterInfo ParameterInfo(SinAmplitudeParameterName);
+	return ParameterInfo;
+}
+
+static const FMaterialParameterInfo& GetSinFrequencyParameterInfo()
+{
+	static const FMaterialParameterInfo ParameterInfo(SinFrequencyParameterName);
+	return ParameterInfo;
+}
 
 // We can also create global logging category of the LogTemp type, which will be available in every project file
 
@@ -63,8 +96,333 @@ void ABaseGeometryActor::BeginPlay()
 	// PrintType();
 	// PrintStringType();
 	PrintTransform();
+	CreateDynamicMaterial();
+	StartGeometry();
+}
+
+void ABaseGeometryActor::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	UE_LOG(LogBaseGeometry, Verbose, TEXT("Actor is dead %s"), *GetName());
+
+	StopGeometry();
+
+	// call the base class function via the super keyword so that we don't lose any
+	Super::EndPlay(EndPlayReason);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void ABaseGeometryActor::ActivateGeometry(const FTransform& Transform, const FGeometryData& Data)
+{
+	SetActorTransform(Transform, false, nullptr, ETeleportType::TeleportPhysics);
+	Initiallocation = Transform.GetLocation();
+	GeometryData = Data;
+	TimerCount = 0;
+
+	SetActorHiddenInGame(false);
+	SetActorEnableCollision(true);
+	SetActorTickEnabled(true);
+
+	StartGeometry();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void ABaseGeometryActor::DeactivateGeometry()
+{
+	StopGeometry();
+
+	SetActorHiddenInGame(true);
+	SetActorEnableCollision(false);
+	SetActorTickEnabled(false);
+
+	// The next owner binds its own handlers and sets its own random key
+	OnColorChanged.Clear();
+	OnTimerFinished.Clear();
+	RandomKey.Reset();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void ABaseGeometryActor::ApplyReplicatedColor(const FLinearColor& Color)
+{
+	GeometryData.Color = Color;
+	SetColor(Color);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void ABaseGeometryActor::SetRandomKey(uint64 Key)
+{
+	RandomKey = Key;
+
+	// A started actor hasn't drawn from its stream yet, the first timer fires TimeRate later
+	if (bGeometryStarted)
+	{
+		SeedColorStream();
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void ABaseGeometryActor::SeedColorStream()
+{
+	if (RandomKey.IsSet())
+	{
+		ColorStream = GeometryRandom::MakeStream(RandomKey.GetValue());
+		return;
+	}
+
+	// The name of an actor loaded with its level is the same in every session, the name of a spawned one depends on the spawn
+	// order of its class, only its location is used then
+	const uint32 LocationHash = GetTypeHash(Initiallocation);
+	ColorStream = GeometryRandom::MakeStream(HasAnyFlags(RF_WasLoaded) ? HashCombine(GetTypeHash(GetFName()), LocationHash) : LocationHash);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void ABaseGeometryActor::SetUseEventQueue(bool bUse)
+{
+	bUseEventQueue = bUse;
+	EventSubsystem = bUseEventQueue && GetWorld() ? GetWorld()->GetSubsystem<UGeometryEventSubsystem>() : nullptr;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+// One live count per EMovementType, the stat macros need the stat name itself
+#define GEOMETRY_COUNT_LIVE(Stat) \
+	if (bLive) \
+	{ \
+		INC_DWORD_STAT(Stat); \
+	} \
+	else \
+	{ \
+		DEC_DWORD_STAT(Stat); \
+	} \
+	break;
+
+static void CountLiveGeometry(EMovementType MoveType, bool bLive)
+{
+	switch (MoveType)
+	{
+	case EMovementType::Sin: GEOMETRY_COUNT_LIVE(STAT_GeometryLiveSinActors)
+	case EMovementType::Static: GEOMETRY_COUNT_LIVE(STAT_GeometryLiveStaticActors)
+	case EMovementType::Orbit: GEOMETRY_COUNT_LIVE(STAT_GeometryLiveOrbitActors)
+	case EMovementType::Bounce: GEOMETRY_COUNT_LIVE(STAT_GeometryLiveBounceActors)
+	case EMovementType::Lissajous: GEOMETRY_COUNT_LIVE(STAT_GeometryLiveLissajousActors)
+	case EMovementType::Custom1: GEOMETRY_COUNT_LIVE(STAT_GeometryLiveCustom1Actors)
+	case EMovementType::Custom2: GEOMETRY_COUNT_LIVE(STAT_GeometryLiveCustom2Actors)
+	case EMovementType::Custom3: GEOMETRY_COUNT_LIVE(STAT_GeometryLiveCustom3Actors)
+	default: break;
+	}
+}
+
+#undef GEOMETRY_COUNT_LIVE
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void ABaseGeometryActor::SetGeometryData(const FGeometryData& Data)
+{
+	GeometryData = Data;
+
+	// E.g. the data set on an actor spawned with SpawnActor, which has already started
+	if (bGeometryStarted && CountedMoveType != GeometryData.MoveType)
+	{
+		CountLiveGeometry(CountedMoveType, false);
+		CountedMoveType = GeometryData.MoveType;
+		CountLiveGeometry(CountedMoveType, true);
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void ABaseGeometryActor::StartGeometry()
+{
+	if (!bGeometryStarted)
+	{
+		bGeometryStarted = true;
+		CountedMoveType = GeometryData.MoveType;
+		CountLiveGeometry(CountedMoveType, true);
+	}
+
+	SeedColorStream();
+
 	SetColor(GeometryData.Color);
 
+	// The server runs the timer of a replicated shape and sends the colors
+	if (!bDrivenByReplication)
+	{
+		StartTimer();
+	}
+
+	SetUseEventQueue(bUseEventQueue);
+
+	// The material moves the shape, nothing is left to do on the CPU
+	if (bUseGPUMovement && GeometryData.MoveType == EMovementType::Sin && StartGPUMovement())
+		return;
+
+	UGeometryMovementSubsystem* MovementSubsystem = GetWorld()->GetSubsystem<UGeometryMovementSubsystem>();
+	if (!MovementSubsystem)
+		return;
+
+	// Sin movement of thousands of actors is much cheaper in one batch than in thousands of ticks
+	if (bUseBatchedMovement && GeometryData.MoveType == EMovementType::Sin)
+	{
+		MovementSubsystem->RegisterActor(this);
+		return;
+	}
+
+	// The other movement models run in one loop per model
+	if (bUseBatchedMovement && GeometryMovement::IsMoving(GeometryData.MoveType))
+	{
+		MovementSubsystem->RegisterGroupActor(this);
+		return;
+	}
+
+	// The actor keeps its own tick, the subsystem lowers its rate when it is far from the camera
+	MovementSubsystem->RegisterTickingActor(this);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void ABaseGeometryActor::StopGeometry()
+{
+	if (bGeometryStarted)
+	{
+		bGeometryStarted = false;
+		CountLiveGeometry(CountedMoveType, false);
+	}
+
+	StopTimer();
+	StopGPUMovement();
+
+	if (MovementIndex != INDEX_NONE || MovementGroup != INDEX_NONE || TickingIndex != INDEX_NONE)
+	{
+		if (UGeometryMovementSubsystem* MovementSubsystem = GetWorld()->GetSubsystem<UGeometryMovementSubsystem>())
+		{
+			MovementSubsystem->UnregisterActor(this);
+			MovementSubsystem->UnregisterGroupActor(this);
+			MovementSubsystem->UnregisterTickingActor(this);
+		}
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+bool ABaseGeometryActor::StartGPUMovement()
+{
+	// Without its own material instance the shape can't be moved by the material, it stays on the CPU path
+	if (!DynMaterial || bGPUMovementActive)
+		return bGPUMovementActive;
+
+	// Sent once, the material evaluates the motion from the world time on its own
+	DynMaterial->SetScalarParameterValueByInfo(GetSinAmplitudeParameterInfo(), GeometryData.Amplitude);
+	DynMaterial->SetScalarParameterValueByInfo(GetSinFrequencyParameterInfo(), GeometryData.Frequency);
+
+	// The offset happens after culling, the bounds must cover the whole motion or the shape pops out at the screen edges
+	DefaultBoundsScale = BaseMesh->BoundsScale;
+	const float Radius = BaseMesh->Bounds.SphereRadius;
+	if (Radius > KINDA_SMALL_NUMBER)
+	{
+		BaseMesh->SetBoundsScale(DefaultBoundsScale * (Radius + FMath::Abs(GeometryData.Amplitude)) / Radius);
+	}
+
+	SetActorTickEnabled(false);
+	bGPUMovementActive = true;
+	return true;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void ABaseGeometryActor::StopGPUMovement()
+{
+	if (!bGPUMovementActive)
+		return;
+
+	bGPUMovementActive = false;
+
+	// A pooled actor may come back as a static shape
+	DynMaterial->SetScalarParameterValueByInfo(GetSinAmplitudeParameterInfo(), 0.0f);
+	BaseMesh->SetBoundsScale(DefaultBoundsScale);
+	SetActorTickEnabled(true);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+FVector ABaseGeometryActor::GetGeometryLocationAtTime(float Time) const
+{
+	if (GeometryData.MoveType == EMovementType::Sin)
+	{
+		FVector Location = GetActorLocation();
+		Location.Z = Initiallocation.Z + GeometryKernels::EvaluateSinOffset(GeometryData.Amplitude, GeometryData.Frequency, Time);
+		return Location;
+	}
+
+	const FGeometryMovementModel* Model = GeometryMovement::FindModel(GeometryData.MoveType);
+	return Model ? Initiallocation + Model->EvaluateOffset(GeometryData.Amplitude, GeometryData.Frequency, Time) : GetActorLocation();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+FVector ABaseGeometryActor::GetGeometryLocation() const
+{
+	const UWorld* World = GetWorld();
+	return GetGeometryLocationAtTime(GeometryKernels::GetMovementTime(World));
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+bool ABaseGeometryActor::ValidateGPUMovement(FString& OutError) const
+{
+	if (!bGPUMovementActive)
+	{
+		OutError = TEXT("GPU movement is not active");
+		return false;
+	}
+
+	if (!GetActorLocation().Equals(Initiallocation))
+	{
+		OutError = FString::Printf(TEXT("the transform was moved on the CPU to %s"), *GetActorLocation().ToString());
+		return false;
+	}
+
+	// The base material must expose the parameters, otherwise the values are set but nothing moves
+	float Amplitude = 0.0f;
+	float Frequency = 0.0f;
+	const UMaterialInterface* Parent = DynMaterial->Parent;
+	if (!Parent || !Parent->GetScalarParameterValue(GetSinAmplitudeParameterInfo(), Amplitude) ||
+	    !Parent->GetScalarParameterValue(GetSinFrequencyParameterInfo(), Frequency))
+	{
+		OutError = FString::Printf(TEXT("material %s has no %s/%s parameters"), *GetNameSafe(Parent), SinAmplitudeParameterName,
+		                           SinFrequencyParameterName);
+		return false;
+	}
+
+	DynMaterial->GetScalarParameterValue(GetSinAmplitudeParameterInfo(), Amplitude);
+	DynMaterial->GetScalarParameterValue(GetSinFrequencyParameterInfo(), Frequency);
+	if (Amplitude != GeometryData.Amplitude || Frequency != GeometryData.Frequency)
+	{
+		OutError = FString::Printf(TEXT("material parameters %f/%f don't match the data %f/%f"), Amplitude, Frequency, GeometryData.Amplitude,
+		                           GeometryData.Frequency);
+		return false;
+	}
+
+	// The CPU query and the batch kernel of the other movement modes must agree
+	static const float SampleTimes[] = {0.0f, 0.37f, 1.5f, 10.0f, 123.4f};
+	for (const float Time : SampleTimes)
+	{
+		float KernelOffset = 0.0f;
+		GeometryKernels::ComputeSinOffsets(&GeometryData.Amplitude, &GeometryData.Frequency, Time, &KernelOffset, 1);
+
+		const float QueryOffset = GetGeometryLocationAtTime(Time).Z - Initiallocation.Z;
+		if (!FMath::IsNearlyEqual(QueryOffset, KernelOffset, GeometryKernels::SinAccuracyBound * FMath::Max(FMath::Abs(GeometryData.Amplitude), 1.0f)))
+		{
+			OutError = FString::Printf(TEXT("query offset %f differs from the kernel offset %f at time %f"), QueryOffset, KernelOffset, Time);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void ABaseGeometryActor::StartTimer()
+{
+	// With thousands of actors one batch per TimeRate is much cheaper than one timer manager entry per actor
+	if (bUseTimerWheel)
+	{
+		if (UGeometryTimerSubsystem* TimerSubsystem = GetWorld()->GetSubsystem<UGeometryTimerSubsystem>())
+		{
+			TimerSubsystem->AddTimer(this, GeometryData.TimeRate);
+			return;
+		}
+	}
+
 	// para 1: reference to the timer handle
 	// para 2: pointer to the object on which we want to call the function every time the timer fires.
 	// we will be calling the function of our actor, so we specify "this"
@@ -76,17 +434,27 @@ void ABaseGeometryActor::BeginPlay()
 	GetWorldTimerManager().SetTimer(TimerHandle, this, &ABaseGeometryActor::OnTimerFired, GeometryData.TimeRate, true);
 }
 
-void ABaseGeometryActor::EndPlay(const EEndPlayReason::Type EndPlayReason)
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void ABaseGeometryActor::StopTimer()
 {
-	UE_LOG(LogBaseGeometry, Error, TEXT("Actor is dead %s"), *GetName());
-	// call the base class function via the super keyword so that we don't lose any
-	Super::EndPlay(EndPlayReason);
+	if (TimerBucket != INDEX_NONE)
+	{
+		if (UGeometryTimerSubsystem* TimerSubsystem = GetWorld()->GetSubsystem<UGeometryTimerSubsystem>())
+		{
+			TimerSubsystem->CancelTimer(this);
+		}
+	}
+
+	GetWorldTimerManager().ClearTimer(TimerHandle);
 }
 
 // Called every frame
 //------------------------------------------------------------------------------------------------------------------------------------------------------
 void ABaseGeometryActor::Tick(float DeltaTime)
 {
+	SCOPE_CYCLE_COUNTER(STAT_GeometryActorTick);
+	TRACE_CPUPROFILER_EVENT_SCOPE(ABaseGeometryActor::Tick);
+
 	Super::Tick(DeltaTime);
 	HandleMovement();
 }
@@ -94,6 +462,7 @@ void ABaseGeometryActor::Tick(float DeltaTime)
 //------------------------------------------------------------------------------------------------------------------------------------------------------
 void ABaseGeometryActor::PrintType()
 {
+#if GEOMETRY_DIAGNOSTIC_LOGGING && WITH_EDITORONLY_DATA
 	// UE_LOG macro has multiple parameters:
 	// 1. log classes
 	// 2. log level: Display, Warning, Error
@@ -105,11 +474,13 @@ void ABaseGeometryActor::PrintType()
 	UE_LOG(LogBaseGeometry, Warning, TEXT("Health: %.2f"), Health);
 	UE_LOG(LogBaseGeometry, Warning, TEXT("IsDead: %d"), IsDead);
 	UE_LOG(LogBaseGeometry, Warning, TEXT("HasWeapon: %d"), static_cast<int>(HasWeapon));
+#endif
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------------------
 void ABaseGeometryActor::PrintStringType()
 {
+#if GEOMETRY_DIAGNOSTIC_LOGGING && WITH_EDITORONLY_DATA
 	FString Name = "John Connor";
 	UE_LOG(LogBaseGeometry, Display, TEXT("Name: %s"), *Name);
 
@@ -137,75 +508,112 @@ void ABaseGeometryActor::PrintStringType()
 		GEngine->AddOnScreenDebugMessage(-1, 6.0f, FColor::Purple, Name);
 		GEngine->AddOnScreenDebugMessage(-1, 6.0f, FColor::Green, State, true, FVector2D(1.5f, 1.5f));
 	}
+#endif
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------------------
 void ABaseGeometryActor::PrintTransform()
 {
+	// Nothing below is built if the Verbose lines are compiled out or switched off for the category
+	if (!UE_LOG_ACTIVE(LogBaseGeometry, Verbose))
+		return;
+
 	FTransform Transform = GetActorTransform();
 	FVector Location = Transform.GetLocation();
 	FRotator Rotator = Transform.Rotator();
 	FVector Scale = Transform.GetScale3D();
 
-	UE_LOG(LogBaseGeometry, Warning, TEXT("Actor name: %s"), *GetName());
-	UE_LOG(LogBaseGeometry, Warning, TEXT("Transform: %s"), *Transform.ToString());
-	UE_LOG(LogBaseGeometry, Warning, TEXT("Location: %s"), *Location.ToString());
-	UE_LOG(LogBaseGeometry, Warning, TEXT("Rotator: %s"), *Rotator.ToString());
-	UE_LOG(LogBaseGeometry, Warning, TEXT("Scale: %s"), *Scale.ToString());
+	UE_LOG(LogBaseGeometry, Verbose, TEXT("Actor name: %s"), *GetName());
+	UE_LOG(LogBaseGeometry, Verbose, TEXT("Transform: %s"), *Transform.ToString());
+	UE_LOG(LogBaseGeometry, Verbose, TEXT("Location: %s"), *Location.ToString());
+	UE_LOG(LogBaseGeometry, Verbose, TEXT("Rotator: %s"), *Rotator.ToString());
+	UE_LOG(LogBaseGeometry, Verbose, TEXT("Scale: %s"), *Scale.ToString());
 
-	UE_LOG(LogBaseGeometry, Error, TEXT("Human transform: %s"), *Transform.ToHumanReadableString());
+	UE_LOG(LogBaseGeometry, Verbose, TEXT("Human transform: %s"), *Transform.ToHumanReadableString());
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------------------
 void ABaseGeometryActor::HandleMovement()
 {
-	switch (GeometryData.MoveType)
-	{
-	case EMovementType::Sin:
-		{
-			FVector CurrentLocation = GetActorLocation();
-			float Time = GetWorld()->GetTimeSeconds();
-			CurrentLocation.Z = Initiallocation.Z + GeometryData.Amplitude * FMath::Sin(GeometryData.Frequency * Time);
-			SetActorLocation(CurrentLocation);
-		}
-		break;
+	SCOPE_CYCLE_COUNTER(STAT_GeometryHandleMovement);
+	TRACE_CPUPROFILER_EVENT_SCOPE(ABaseGeometryActor::HandleMovement);
 
-	case EMovementType::Static: break;
-	default: break;
+	// Only actors that move themselves get here, the batched ones are moved by UGeometryMovementSubsystem
+	if (!GeometryMovement::IsMoving(GeometryData.MoveType))
+		return;
+
+	SetActorLocation(GetGeometryLocationAtTime(GeometryKernels::GetMovementTime(GetWorld())));
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void ABaseGeometryActor::CreateDynamicMaterial()
+{
+	if (!BaseMesh || DynMaterial)
+		return;
+
+	// One MID for the whole life of the actor, a pooled actor keeps it between activations
+	DynMaterial = BaseMesh->CreateAndSetMaterialInstanceDynamic(0);
+	if (DynMaterial)
+	{
+		INC_DWORD_STAT(STAT_GeometryMIDAllocations);
+		INC_DWORD_STAT(STAT_GeometryMIDAllocationsTotal);
 	}
 }
 
+//------------------------------------------------------------------------------------------------------------------------------------------------------
 void ABaseGeometryActor::SetColor(const FLinearColor& Color)
 {
-	if (!BaseMesh)
-		return;
+	SCOPE_CYCLE_COUNTER(STAT_GeometrySetColor);
+	TRACE_CPUPROFILER_EVENT_SCOPE(ABaseGeometryActor::SetColor);
+
+	// The parameter info is built once, later calls only update the value
+	static const FMaterialParameterInfo ColorParameterInfo(TEXT("Color"));
 
-	UMaterialInstanceDynamic* DynMaterial = BaseMesh->CreateAndSetMaterialInstanceDynamic(0);
 	if (DynMaterial)
 	{
-		DynMaterial->SetVectorParameterValue("Color", Color);
+		DynMaterial->SetVectorParameterValueByInfo(ColorParameterInfo, Color);
 	}
 }
 
 void ABaseGeometryActor::OnTimerFired()
 {
+	SCOPE_CYCLE_COUNTER(STAT_GeometryOnTimerFired);
+	TRACE_CPUPROFILER_EVENT_SCOPE(ABaseGeometryActor::OnTimerFired);
+
 	if (++TimerCount <= MaxTimerCount)
 	{
-		const FLinearColor NewColor = FLinearColor::MakeRandomColor();
-		UE_LOG(LogBaseGeometry, Display, TEXT("TimerCount: %i, Color to setup: %s"), TimerCount, *NewColor.ToString());
+		const FLinearColor NewColor = ColorStream.NextColor();
+		UE_LOG(LogBaseGeometry, Verbose, TEXT("TimerCount: %i, Color to setup: %s"), TimerCount, *NewColor.ToString());
 		SetColor(NewColor);
-		// GetName's function is to get the name of the actor
-		// GetName 函数的作用是获取当前 ABaseGeometryActor 实例（即当前 Actor）的名字。
-		OnColorChanged.Broadcast(NewColor, GetName());
+
+		if (EventSubsystem)
+		{
+			EventSubsystem->Push(this, EGeometryEventType::ColorChanged, NewColor);
+		}
+
+		// The dynamic delegate goes through reflection, only pay for it if somebody (e.g. a blueprint) listens
+		if (OnColorChanged.IsBound())
+		{
+			// GetName's function is to get the name of the actor
+			// GetName 函数的作用是获取当前 ABaseGeometryActor 实例（即当前 Actor）的名字。
+			OnColorChanged.Broadcast(NewColor, GetName());
+			INC_DWORD_STAT(STAT_GeometryDelegateBroadcasts);
+		}
 	}
 	else
 	{
-		UE_LOG(LogBaseGeometry, Warning, TEXT("Timer has been stoped"));
-		GetWorldTimerManager().ClearTimer(TimerHandle);
+		UE_LOG(LogBaseGeometry, Verbose, TEXT("Timer has been stoped"));
+		StopTimer();
 		// We pass the pointer to the current actor as a parameter, this is, in fact, a pointer to BaseGeometryActor
 		// But in the delegate signature we specified the parameter as pointer to the base class of the actor-AActor
 		// In fact, when the Broadcast funciton is called, an automatic up-cast -- the conversion of a pointer from
 		// ABaseGeometryActor to a pointer to just AActor.
+		if (EventSubsystem)
+		{
+			EventSubsystem->Push(this, EGeometryEventType::TimerFinished);
+		}
+
 		OnTimerFinished.Broadcast(this);
+		INC_DWORD_STAT(STAT_GeometryDelegateBroadcasts);
 	}
 }
@@ -0,0 +1,141 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GeometryActorPool.h"
+#include "Engine/World.h"
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryActorPool::Prewarm(TSubclassOf<ABaseGeometryActor> GeometryClass, int32 Count)
+{
+	if (!GeometryClass || Count <= 0)
+		return;
+
+	FGeometryActorPoolList& List = Pools.FindOrAdd(GeometryClass);
+	// Not for the single actors of the time-sliced prewarm, an exact reserve per actor would reallocate every time
+	if (Count > 1)
+	{
+		List.FreeActors.Reserve(List.FreeActors.Num() + Count);
+	}
+
+	for (int32 i = 0; i < Count; ++i)
+	{
+		ABaseGeometryActor* Geometry = SpawnGeometry(GeometryClass, FTransform::Identity, FGeometryData());
+		if (!Geometry)
+			break;
+
+		Geometry->DeactivateGeometry();
+		List.FreeActors.Add(Geometry);
+		PooledActors.Add(Geometry, false);
+		++NumFreeActors;
+	}
+
+	UpdatePeaks();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+ABaseGeometryActor* UGeometryActorPool::Acquire(TSubclassOf<ABaseGeometryActor> GeometryClass, const FTransform& Transform, const FGeometryData& Data)
+{
+	if (!GeometryClass)
+		return nullptr;
+
+	++Stats.NumAcquired;
+
+	FGeometryActorPoolList* List = Pools.Find(GeometryClass);
+	while (List && List->FreeActors.Num() > 0)
+	{
+		ABaseGeometryActor* Geometry = List->FreeActors.Pop(false);
+		--NumFreeActors;
+
+		// The actor may have been destroyed from the outside while it was waiting in the pool
+		if (!IsValid(Geometry))
+		{
+			PooledActors.Remove(Geometry);
+			continue;
+		}
+
+		PooledActors.Add(Geometry, true);
+		++Stats.NumHits;
+		++NumActiveActors;
+		Geometry->ActivateGeometry(Transform, Data);
+		return Geometry;
+	}
+
+	++Stats.NumMisses;
+	ABaseGeometryActor* Geometry = SpawnGeometry(GeometryClass, Transform, Data);
+	if (Geometry)
+	{
+		PooledActors.Add(Geometry, true);
+		++NumActiveActors;
+		UpdatePeaks();
+	}
+	return Geometry;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+bool UGeometryActorPool::Release(ABaseGeometryActor* Actor)
+{
+	if (!IsValid(Actor))
+		return false;
+
+	// An actor spawned elsewhere still belongs to its owner, the pool would hand it out while the owner uses it
+	bool* bActive = PooledActors.Find(Actor);
+	if (!bActive)
+		return false;
+
+	// Already in FreeActors, a second entry would be handed out twice
+	if (!ensureMsgf(*bActive, TEXT("%s is released to the pool twice"), *Actor->GetName()))
+		return true;
+
+	*bActive = false;
+	Actor->DeactivateGeometry();
+	Pools.FindOrAdd(Actor->GetClass()).FreeActors.Add(Actor);
+
+	++Stats.NumReleased;
+	++NumFreeActors;
+	NumActiveActors = FMath::Max(NumActiveActors - 1, 0);
+	UpdatePeaks();
+	return true;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryActorPool::Clear()
+{
+	for (TPair<TSubclassOf<ABaseGeometryActor>, FGeometryActorPoolList>& Pair : Pools)
+	{
+		for (ABaseGeometryActor* Geometry : Pair.Value.FreeActors)
+		{
+			if (IsValid(Geometry))
+			{
+				Geometry->Destroy();
+			}
+			PooledActors.Remove(Geometry);
+		}
+	}
+
+	Pools.Reset();
+	NumFreeActors = 0;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+ABaseGeometryActor* UGeometryActorPool::SpawnGeometry(TSubclassOf<ABaseGeometryActor> GeometryClass, const FTransform& Transform,
+                                                      const FGeometryData& Data)
+{
+	UWorld* World = GetWorld();
+	if (!World)
+		return nullptr;
+
+	ABaseGeometryActor* Geometry = World->SpawnActorDeferred<ABaseGeometryActor>(GeometryClass, Transform);
+	if (Geometry)
+	{
+		Geometry->SetGeometryData(Data);
+		Geometry->FinishSpawning(Transform);
+	}
+	return Geometry;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryActorPool::UpdatePeaks()
+{
+	Stats.PeakFreeActors = FMath::Max(Stats.PeakFreeActors, NumFreeActors);
+	Stats.PeakTotalActors = FMath::Max(Stats.PeakTotalActors, NumFreeActors + NumActiveActors);
+}
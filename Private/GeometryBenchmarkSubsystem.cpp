@@ -0,0 +1,276 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GeometryBenchmarkSubsystem.h"
+#include "GeometryMovementModels.h"
+#include "GeometryRandom.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+#include "Dom/JsonObject.h"
+#include "Misc/App.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/ArchiveCountMem.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogGeometryBenchmark, All, All)
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+TStatId UGeometryBenchmarkSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UGeometryBenchmarkSubsystem, STATGROUP_Tickables);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryBenchmarkSubsystem::StartBenchmark(const TArray<int32>& ActorCounts, int32 NumFrames, bool bExitWhenDone, bool bWriteResults)
+{
+	if (IsRunning())
+	{
+		UE_LOG(LogGeometryBenchmark, Warning, TEXT("Benchmark is already running"));
+		return;
+	}
+
+	const TArray<EMovementType> MoveTypes = GetBenchmarkedMoveTypes();
+
+	Cases.Reset();
+	for (const int32 NumActors : ActorCounts)
+	{
+		for (const EMovementType MoveType : MoveTypes)
+		{
+			FCase& Case = Cases.AddDefaulted_GetRef();
+			Case.NumActors = NumActors;
+			Case.MoveType = MoveType;
+		}
+	}
+
+	if (Cases.Num() == 0)
+		return;
+
+	NumFramesPerCase = FMath::Max(NumFrames, 1);
+	bExit = bExitWhenDone;
+	bWrite = bWriteResults;
+	CaseIndex = 0;
+	BeginCase();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+TArray<EMovementType> UGeometryBenchmarkSubsystem::GetBenchmarkedMoveTypes()
+{
+	TArray<EMovementType> MoveTypes = {EMovementType::Static};
+	for (int32 Index = 0; Index < GeometryMovement::MaxMovementTypes; ++Index)
+	{
+		const EMovementType MoveType = static_cast<EMovementType>(Index);
+		if (GeometryMovement::FindModel(MoveType))
+		{
+			MoveTypes.Add(MoveType);
+		}
+	}
+	return MoveTypes;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryBenchmarkSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	if (!IsRunning())
+		return;
+
+	// Wall time between two ticks of the subsystem is the full frame time, including the render thread wait
+	const double Now = FPlatformTime::Seconds();
+	const double FrameMs = (Now - LastFrameTime) * 1000.0;
+	LastFrameTime = Now;
+
+	if (++FrameCounter > NumWarmupFrames)
+	{
+		FrameTimes.Add(FrameMs);
+	}
+
+	if (FrameTimes.Num() < NumFramesPerCase)
+		return;
+
+	EndCase();
+
+	if (++CaseIndex < Cases.Num())
+	{
+		BeginCase();
+		return;
+	}
+
+	CaseIndex = INDEX_NONE;
+	if (bWrite)
+	{
+		WriteResults();
+	}
+
+	if (bExit)
+	{
+		FPlatformMisc::RequestExit(false);
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryBenchmarkSubsystem::BeginCase()
+{
+	FCase& Case = Cases[CaseIndex];
+	UWorld* World = GetWorld();
+
+	FGeometryData Data;
+	Data.MoveType = Case.MoveType;
+
+	SpawnedActors.Reset(Case.NumActors);
+	const double StartTime = FPlatformTime::Seconds();
+
+	for (int32 i = 0; i < Case.NumActors; ++i)
+	{
+		const FTransform Transform(FVector(300.0f * (i % 1000), 300.0f * (i / 1000), 330.0f));
+		ABaseGeometryActor* Geometry = World->SpawnActorDeferred<ABaseGeometryActor>(ABaseGeometryActor::StaticClass(), Transform);
+		if (Geometry)
+		{
+			Geometry->SetGeometryData(Data);
+			Geometry->FinishSpawning(Transform);
+			SpawnedActors.Add(Geometry);
+		}
+	}
+
+	Case.SpawnMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+	// Counted outside the spawn time. Unlike the process memory, it doesn't include allocator slack or what other systems allocated meanwhile
+	SIZE_T ActorBytes = 0;
+	for (const ABaseGeometryActor* Geometry : SpawnedActors)
+	{
+		ActorBytes += GetActorMemoryBytes(Geometry);
+	}
+	Case.BytesPerActor = SpawnedActors.Num() > 0 ? static_cast<double>(ActorBytes) / SpawnedActors.Num() : 0.0;
+
+	FrameTimes.Reset(NumFramesPerCase);
+	FrameCounter = 0;
+	LastFrameTime = FPlatformTime::Seconds();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+SIZE_T UGeometryBenchmarkSubsystem::GetActorMemoryBytes(const AActor* Actor)
+{
+	if (!Actor)
+		return 0;
+
+	// UObject::Serialize counts the structure size of the class, the properties count their heap allocations
+	SIZE_T Bytes = FArchiveCountMem(const_cast<AActor*>(Actor)).GetMax();
+	for (UActorComponent* Component : Actor->GetComponents())
+	{
+		Bytes += FArchiveCountMem(Component).GetMax();
+	}
+	return Bytes;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryBenchmarkSubsystem::EndCase()
+{
+	FCase& Case = Cases[CaseIndex];
+
+	double Sum = 0.0;
+	for (const double FrameMs : FrameTimes)
+	{
+		Sum += FrameMs;
+	}
+	Case.AverageFrameMs = Sum / FrameTimes.Num();
+
+	FrameTimes.Sort();
+	const int32 P99Index = FMath::Clamp(FMath::CeilToInt(FrameTimes.Num() * 0.99) - 1, 0, FrameTimes.Num() - 1);
+	Case.P99FrameMs = FrameTimes[P99Index];
+
+	UE_LOG(LogGeometryBenchmark, Display, TEXT("%7d actors %-6s: spawn %.2f ms, frame avg %.3f ms, p99 %.3f ms, %.0f bytes/actor"), Case.NumActors,
+	       *UEnum::GetDisplayValueAsText(Case.MoveType).ToString(), Case.SpawnMs, Case.AverageFrameMs, Case.P99FrameMs, Case.BytesPerActor);
+
+	for (ABaseGeometryActor* Geometry : SpawnedActors)
+	{
+		if (IsValid(Geometry))
+		{
+			Geometry->Destroy();
+		}
+	}
+	SpawnedActors.Reset();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryBenchmarkSubsystem::WriteResults() const
+{
+	TArray<TSharedPtr<FJsonValue>> Results;
+	for (const FCase& Case : Cases)
+	{
+		const TSharedRef<FJsonObject> Result = MakeShared<FJsonObject>();
+		Result->SetNumberField(TEXT("actors"), Case.NumActors);
+		Result->SetStringField(TEXT("moveType"), UEnum::GetValueAsString(Case.MoveType));
+		Result->SetNumberField(TEXT("spawnMs"), Case.SpawnMs);
+		Result->SetNumberField(TEXT("spawnUsPerActor"), Case.NumActors > 0 ? Case.SpawnMs * 1000.0 / Case.NumActors : 0.0);
+		Result->SetNumberField(TEXT("frameAvgMs"), Case.AverageFrameMs);
+		Result->SetNumberField(TEXT("frameP99Ms"), Case.P99FrameMs);
+		Result->SetNumberField(TEXT("bytesPerActor"), Case.BytesPerActor);
+		Results.Add(MakeShared<FJsonValueObject>(Result));
+	}
+
+	const TSharedRef<FJsonObject> Root = MakeShared<FJsonObject>();
+	Root->SetStringField(TEXT("buildConfiguration"), LexToString(FApp::GetBuildConfiguration()));
+	Root->SetNumberField(TEXT("framesPerCase"), NumFramesPerCase);
+	Root->SetNumberField(TEXT("randomSeed"), static_cast<double>(GeometryRandom::GetSeed()));
+	Root->SetArrayField(TEXT("results"), Results);
+
+	FString Json;
+	const TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Json);
+	FJsonSerializer::Serialize(Root, Writer);
+
+	const FString FilePath = FPaths::ProjectSavedDir() / TEXT("Benchmarks") / TEXT("GeometryBenchmark.json");
+	if (FFileHelper::SaveStringToFile(Json, *FilePath))
+	{
+		UE_LOG(LogGeometryBenchmark, Display, TEXT("Benchmark results written to %s"), *FilePath);
+	}
+	else
+	{
+		UE_LOG(LogGeometryBenchmark, Error, TEXT("Failed to write the benchmark results to %s"), *FilePath);
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+// Usage: geometry.Benchmark.Run [Counts=100+1000+10000+100000] [NumFrames=120] [-exit]
+static FAutoConsoleCommandWithWorldAndArgs GGeometryBenchmarkRunCommand(
+	TEXT("geometry.Benchmark.Run"),
+	TEXT("Runs the geometry actor benchmark and writes Saved/Benchmarks/GeometryBenchmark.json."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		UGeometryBenchmarkSubsystem* Benchmark = World ? World->GetSubsystem<UGeometryBenchmarkSubsystem>() : nullptr;
+		if (!Benchmark)
+			return;
+
+		TArray<int32> ActorCounts = {100, 1000, 10000, 100000};
+		int32 NumFrames = 120;
+		bool bExitWhenDone = false;
+
+		int32 NumPositional = 0;
+		for (const FString& Arg : Args)
+		{
+			if (Arg == TEXT("-exit"))
+			{
+				bExitWhenDone = true;
+			}
+			else if (NumPositional++ == 0)
+			{
+				// '+' works inside -ExecCmds, which splits the commands at commas
+				static const TCHAR* Delimiters[] = {TEXT(","), TEXT("+")};
+				TArray<FString> Values;
+				Arg.ParseIntoArray(Values, Delimiters, UE_ARRAY_COUNT(Delimiters));
+				ActorCounts.Reset();
+				for (const FString& Value : Values)
+				{
+					ActorCounts.Add(FCString::Atoi(*Value));
+				}
+			}
+			else
+			{
+				NumFrames = FCString::Atoi(*Arg);
+			}
+		}
+
+		Benchmark->StartBenchmark(ActorCounts, NumFrames, bExitWhenDone);
+	}));
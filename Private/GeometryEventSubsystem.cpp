@@ -0,0 +1,75 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GeometryEventSubsystem.h"
+#include "BaseGeometryActor.h"
+#include "GeometryStats.h"
+#include "Misc/ScopeLock.h"
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryEventSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	Buffer.SetNum(InitialCapacity);
+	BroadcastBuffer.SetNum(InitialCapacity);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+TStatId UGeometryEventSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UGeometryEventSubsystem, STATGROUP_Tickables);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryEventSubsystem::Push(ABaseGeometryActor* Actor, EGeometryEventType Type, const FLinearColor& Color)
+{
+	FGeometryEvent Event;
+	Event.Actor = Actor;
+	Event.Color = Color.QuantizeRound();
+	Event.Type = Type;
+
+	const int32 Index = WriteIndex.fetch_add(1, std::memory_order_relaxed);
+	if (Index < Buffer.Num())
+	{
+		Buffer[Index] = Event;
+		return;
+	}
+
+	FScopeLock Lock(&OverflowLock);
+	Overflow.Add(Event);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryEventSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+	Flush();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryEventSubsystem::Flush()
+{
+	int32 Num = FMath::Min(WriteIndex.load(std::memory_order_acquire), Buffer.Num());
+	if (Num == 0)
+		return;
+
+	if (Overflow.Num() > 0)
+	{
+		// Busy frame: the buffer grows, so next frames of the same size stay on the lock-free path
+		Buffer.Append(Overflow);
+		Num = Buffer.Num();
+		Overflow.Reset();
+	}
+
+	// Listeners may push while they handle the events: those go to the other buffer and are broadcast next frame
+	Swap(Buffer, BroadcastBuffer);
+	if (Buffer.Num() < BroadcastBuffer.Num())
+	{
+		Buffer.SetNum(BroadcastBuffer.Num());
+	}
+	WriteIndex.store(0, std::memory_order_release);
+
+	INC_DWORD_STAT_BY(STAT_GeometryQueuedEvents, Num);
+	OnEvents.Broadcast(MakeArrayView(BroadcastBuffer.GetData(), Num));
+}
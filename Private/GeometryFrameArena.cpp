@@ -0,0 +1,166 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GeometryFrameArena.h"
+#include "GeometryStats.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/CoreDelegates.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogGeometryFrameArena, All, All)
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Frame Arena Used Bytes"), STAT_GeometryFrameArenaUsed, STATGROUP_GeometryActors);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Frame Arena High Water Bytes"), STAT_GeometryFrameArenaHighWater, STATGROUP_GeometryActors);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Frame Arena Block Allocations"), STAT_GeometryFrameArenaBlocks, STATGROUP_GeometryActors);
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+FGeometryFrameArena& FGeometryFrameArena::Get()
+{
+	// Never destroyed: the blocks are given back with the process, nothing is unbound from FCoreDelegates during static destruction
+	static FGeometryFrameArena* Arena = new FGeometryFrameArena();
+	return *Arena;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+FGeometryFrameArena::FGeometryFrameArena()
+{
+	FCoreDelegates::OnBeginFrame.AddRaw(this, &FGeometryFrameArena::BeginFrame);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void FGeometryFrameArena::BeginFrame()
+{
+	// The size of the frame which just ended
+	SET_DWORD_STAT(STAT_GeometryFrameArenaUsed, UsedBytes);
+	SET_DWORD_STAT(STAT_GeometryFrameArenaHighWater, HighWaterMark);
+
+	Reset();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void* FGeometryFrameArena::Allocate(SIZE_T Size, uint32 Alignment)
+{
+	check(IsInGameThread());
+
+	for (;;)
+	{
+		if (CurrentBlock < Blocks.Num())
+		{
+			const FBlock& Block = Blocks[CurrentBlock];
+			uint8* Start = Align(Block.Data + BlockOffset, Alignment);
+			uint8* End = Start + Size;
+			if (End <= Block.Data + Block.Size)
+			{
+				UsedBytes += End - (Block.Data + BlockOffset);
+				HighWaterMark = FMath::Max(HighWaterMark, UsedBytes);
+				BlockOffset = End - Block.Data;
+				LastAllocation = Start;
+				return Start;
+			}
+
+			// The rest of the block stays unused until the reset
+			UsedBytes += Block.Size - BlockOffset;
+			++CurrentBlock;
+			BlockOffset = 0;
+			continue;
+		}
+
+		const SIZE_T NextBlockSize = Blocks.Num() > 0 ? Blocks.Last().Size * 2 : DefaultBlockSize;
+		AddBlock(FMath::Max(NextBlockSize, Size + Alignment));
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void* FGeometryFrameArena::Reallocate(void* Data, SIZE_T NumBytesToCopy, SIZE_T NewSize, uint32 Alignment)
+{
+	check(IsInGameThread());
+
+	if (Data && Data == LastAllocation)
+	{
+		const FBlock& Block = Blocks[CurrentBlock];
+		const SIZE_T Start = LastAllocation - Block.Data;
+		if (Start + NewSize <= Block.Size)
+		{
+			UsedBytes = UsedBytes - BlockOffset + Start + NewSize;
+			HighWaterMark = FMath::Max(HighWaterMark, UsedBytes);
+			BlockOffset = Start + NewSize;
+			return Data;
+		}
+	}
+
+	void* NewData = Allocate(NewSize, Alignment);
+	if (Data && NumBytesToCopy > 0)
+	{
+		FMemory::Memcpy(NewData, Data, FMath::Min(NumBytesToCopy, NewSize));
+	}
+	return NewData;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void FGeometryFrameArena::Reset()
+{
+	check(IsInGameThread());
+
+	// One block as large as all of them, so the next frame of the same size fits without a new block
+	if (Blocks.Num() > 1)
+	{
+		const SIZE_T Capacity = GetCapacity();
+		for (const FBlock& Block : Blocks)
+		{
+			FMemory::Free(Block.Data);
+		}
+		Blocks.Reset();
+		AddBlock(Capacity);
+	}
+
+#if DO_GUARD_SLOW
+	// Arrays kept past the end of the frame read garbage instead of the old values
+	for (const FBlock& Block : Blocks)
+	{
+		FMemory::Memset(Block.Data, 0xDD, Block.Size);
+	}
+#endif
+
+	CurrentBlock = 0;
+	BlockOffset = 0;
+	UsedBytes = 0;
+	LastAllocation = nullptr;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+SIZE_T FGeometryFrameArena::GetCapacity() const
+{
+	SIZE_T Capacity = 0;
+	for (const FBlock& Block : Blocks)
+	{
+		Capacity += Block.Size;
+	}
+	return Capacity;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void FGeometryFrameArena::AddBlock(SIZE_T Size)
+{
+	FBlock& Block = Blocks.AddDefaulted_GetRef();
+	Block.Data = static_cast<uint8*>(FMemory::Malloc(Size, PLATFORM_CACHE_LINE_SIZE));
+	Block.Size = Size;
+
+	++NumBlockAllocations;
+	SET_DWORD_STAT(STAT_GeometryFrameArenaBlocks, NumBlockAllocations);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+// Usage: geometry.FrameArena.Report [-reset]
+static FAutoConsoleCommand GGeometryFrameArenaReportCommand(
+	TEXT("geometry.FrameArena.Report"),
+	TEXT("Logs the high-water mark, capacity and block allocations of the geometry frame arena, -reset restarts the high-water mark."),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		FGeometryFrameArena& Arena = FGeometryFrameArena::Get();
+		UE_LOG(LogGeometryFrameArena, Display, TEXT("High water %llu bytes, capacity %llu bytes, %d block allocations"),
+		       static_cast<uint64>(Arena.GetHighWaterMark()), static_cast<uint64>(Arena.GetCapacity()), Arena.GetNumBlockAllocations());
+
+		if (Args.Contains(TEXT("-reset")))
+		{
+			Arena.ResetHighWaterMark();
+		}
+	}));
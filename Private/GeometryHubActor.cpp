@@ -4,28 +4,245 @@
 #include "GeometryHubActor.h"
 #include "Math/Transform.h"
 #include "Engine/World.h"
+#include "Engine/AssetManager.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/Paths.h"
+#include "Net/UnrealNetwork.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "GeometryLogging.h"
+#include "GeometryMassSubsystem.h"
+#include "GeometryMovementModels.h"
+#include "GeometryStats.h"
 
 // LogGeometryHub is the name of DEFINE_LOG_CATEGORY_STATIC 
-DEFINE_LOG_CATEGORY_STATIC(LogGeometryHub, All, All)
+DEFINE_LOG_CATEGORY_STATIC(LogGeometryHub, GEOMETRY_LOG_DEFAULT_VERBOSITY, GEOMETRY_LOG_COMPILE_VERBOSITY)
+
+DECLARE_CYCLE_STAT(TEXT("DoActorSpawn"), STAT_GeometryDoActorSpawn, STATGROUP_GeometryActors);
+DECLARE_CYCLE_STAT(TEXT("Spawn Payloads Within Budget"), STAT_GeometrySpawnWithinBudget, STATGROUP_GeometryActors);
+DECLARE_CYCLE_STAT(TEXT("Hub Events"), STAT_GeometryHubEvents, STATGROUP_GeometryActors);
+DECLARE_CYCLE_STAT(TEXT("Spatial Index Refresh"), STAT_GeometrySpatialRefresh, STATGROUP_GeometryActors);
+DECLARE_CYCLE_STAT(TEXT("Retire Within Budget"), STAT_GeometryRetireWithinBudget, STATGROUP_GeometryActors);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Retire Queue"), STAT_GeometryRetireQueue, STATGROUP_GeometryActors);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Retired Actors"), STAT_GeometryRetiredActors, STATGROUP_GeometryActors);
+DECLARE_CYCLE_STAT(TEXT("Streaming Cells Update"), STAT_GeometryStreamingUpdate, STATGROUP_GeometryActors);
+DECLARE_CYCLE_STAT(TEXT("Streaming Cells Spawn"), STAT_GeometryStreamingSpawn, STATGROUP_GeometryActors);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Loaded Streaming Cells"), STAT_GeometryLoadedStreamingCells, STATGROUP_GeometryActors);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Streaming Cell Loads"), STAT_GeometryStreamingCellLoads, STATGROUP_GeometryActors);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Streaming Cell Unloads"), STAT_GeometryStreamingCellUnloads, STATGROUP_GeometryActors);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Replication Bytes/s Sent"), STAT_GeometryReplicationBytesSent, STATGROUP_GeometryActors);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Replication Bytes/s Received"), STAT_GeometryReplicationBytesReceived, STATGROUP_GeometryActors);
+
+static TAutoConsoleVariable<bool> CVarGeometryLogReplicationBandwidth(
+	TEXT("geometry.Replication.LogBandwidth"),
+	false,
+	TEXT("If true, every hub replicating geometry logs the bytes per second it sent or received once per second."));
 
 // Sets default values
 AGeometryHubActor::AGeometryHubActor()
 {
 	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
 	PrimaryActorTick.bCanEverTick = true;
+
+	InstanceRenderer = CreateDefaultSubobject<UGeometryInstanceRendererComponent>("InstanceRenderer");
+
+	// Replicated from the start, so the hub placed in the level is matched with the server one on clients.
+	// Nothing is sent unless bReplicateGeometry is set.
+	bReplicates = true;
+	bAlwaysRelevant = true;
+	// The shapes only change on color changes, a few updates per second batch them into fewer packets
+	NetUpdateFrequency = 10.0f;
+	ReplicatedGeometry.Owner = this;
+}
+
+void AGeometryHubActor::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(AGeometryHubActor, ReplicatedGeometry);
 }
 
 // Called when the game starts or when spawned
 void AGeometryHubActor::BeginPlay()
 {
 	Super::BeginPlay();
+
+	SpatialIndex.SetCellSize(SpatialCellSize);
+	RandomStream = GeometryRandom::MakeStream(GetTypeHash(GetFName()));
+
+	if (bUseActorPool)
+	{
+		ActorPool = NewObject<UGeometryActorPool>(this);
+	}
+
+	// The replicating server gets the color changes from the queue
+	if (bUseEventQueue || IsReplicatingGeometry())
+	{
+		if (UGeometryEventSubsystem* EventSubsystem = GetWorld()->GetSubsystem<UGeometryEventSubsystem>())
+		{
+			GeometryEventsHandle = EventSubsystem->OnEvents.AddUObject(this, &AGeometryHubActor::OnGeometryEvents);
+		}
+	}
+
+	if (bOverrideSignificanceSettings)
+	{
+		if (UGeometryMovementSubsystem* MovementSubsystem = GetWorld()->GetSubsystem<UGeometryMovementSubsystem>())
+		{
+			MovementSubsystem->SetSignificanceSettings(SignificanceSettings);
+		}
+	}
+
+	BandwidthWindowStart = FPlatformTime::Seconds();
+	// Pauses to compare with and without bDeferredRetirement, see geometry.GC.Report
+	GeometryGC::StartTracking();
+
+	// The shapes come from the server, see SpawnReplicatedGeometry
+	if (bReplicateGeometry && GetNetMode() == NM_Client)
+		return;
+
+	OpenLayout();
 	DoActorSpawn();
 }
 
+void AGeometryHubActor::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (GeometryEventsHandle.IsValid())
+	{
+		if (UGeometryEventSubsystem* EventSubsystem = GetWorld()->GetSubsystem<UGeometryEventSubsystem>())
+		{
+			EventSubsystem->OnEvents.Remove(GeometryEventsHandle);
+		}
+		GeometryEventsHandle.Reset();
+	}
+
+	if (PayloadClassesHandle.IsValid())
+	{
+		PayloadClassesHandle->CancelHandle();
+		PayloadClassesHandle.Reset();
+	}
+	NextDemoIndex = NumDemoActors;
+	PendingPrewarm.Reset();
+	NextPayloadIndex = INDEX_NONE;
+	StreamingCells.Reset();
+	LoadedCellKeys.Reset();
+	PendingCellSpawns.Reset();
+	StreamedActorCells.Reset();
+	SET_DWORD_STAT(STAT_GeometryLoadedStreamingCells, 0);
+	FlushRetireQueue();
+	CloseLayout();
+	SpatialIndex.Reset();
+
+	if (ActorPool)
+	{
+		const FGeometryActorPoolStats& Stats = ActorPool->GetStats();
+		UE_LOG(LogGeometryHub, Display, TEXT("Pool: %d acquired, hit rate %.1f%%, peak %d free / %d total actors"), Stats.NumAcquired,
+		       Stats.GetHitRate() * 100.0f, Stats.PeakFreeActors, Stats.PeakTotalActors);
+		ActorPool->Clear();
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+FGeometryActorPoolStats AGeometryHubActor::GetPoolStats() const
+{
+	return ActorPool ? ActorPool->GetStats() : FGeometryActorPoolStats();
+}
+
 // Called every frame
 void AGeometryHubActor::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
+
+	if (NextPayloadIndex != INDEX_NONE)
+	{
+		SpawnPayloadsWithinBudget();
+	}
+
+	if (StreamingCells.Num() > 0)
+	{
+		UpdateStreamingCells();
+	}
+
+	if (PendingCellSpawns.Num() > 0)
+	{
+		SpawnStreamedItemsWithinBudget();
+	}
+
+	if (RetireQueueHead < RetireQueue.Num())
+	{
+		RetireWithinBudget();
+	}
+
+	if (bReplicateGeometry)
+	{
+		UpdateReplicationBandwidth();
+	}
+
+	// Only the moving actors are refreshed, the static entries are not touched
+	SCOPE_CYCLE_COUNTER(STAT_GeometrySpatialRefresh);
+	TRACE_CPUPROFILER_EVENT_SCOPE(AGeometryHubActor::RefreshSpatialIndex);
+	SpatialIndex.RefreshMovingEntries();
+}
+
+TArray<ABaseGeometryActor*> AGeometryHubActor::QueryGeometryInSphere(const FVector& Center, float Radius) const
+{
+	TArray<ABaseGeometryActor*> Result;
+	CollectGeometryInSphere(Center, Radius, Result);
+	return Result;
+}
+
+TArray<ABaseGeometryActor*> AGeometryHubActor::QueryGeometryInBox(const FBox& Box) const
+{
+	TArray<ABaseGeometryActor*> Result;
+	CollectGeometryInBox(Box, Result);
+	return Result;
+}
+
+void AGeometryHubActor::CollectGeometryInSphere(const FVector& Center, float Radius, TArray<ABaseGeometryActor*>& OutActors) const
+{
+	SpatialIndex.QuerySphere(Center, Radius, OutActors);
+}
+
+void AGeometryHubActor::CollectGeometryInBox(const FBox& Box, TArray<ABaseGeometryActor*>& OutActors) const
+{
+	SpatialIndex.QueryBox(Box, OutActors);
+}
+
+void AGeometryHubActor::CollectGeometryInSphere(const FVector& Center, float Radius, TGeometryFrameArray<ABaseGeometryActor*>& OutActors) const
+{
+	SpatialIndex.QuerySphere(Center, Radius, OutActors);
+}
+
+void AGeometryHubActor::CollectGeometryInBox(const FBox& Box, TGeometryFrameArray<ABaseGeometryActor*>& OutActors) const
+{
+	SpatialIndex.QueryBox(Box, OutActors);
+}
+
+TArray<ABaseGeometryActor*> AGeometryHubActor::PromoteMassGeometryInSphere(const FVector& Center, float Radius)
+{
+	TArray<ABaseGeometryActor*> Result;
+
+	UGeometryMassSubsystem* MassSubsystem = GetWorld()->GetSubsystem<UGeometryMassSubsystem>();
+	if (!MassSubsystem)
+		return Result;
+
+	// Collected first, promoting destroys entities and must not happen while the query iterates the chunks
+	TArray<FMassEntityHandle> Entities;
+	MassSubsystem->CollectEntitiesInSphere(Center, Radius, Entities);
+
+	for (const FMassEntityHandle& Entity : Entities)
+	{
+		if (ABaseGeometryActor* Geometry = MassSubsystem->PromoteToActor(Entity))
+		{
+			BindGeometry(Geometry);
+			TrackGeometry(Geometry);
+			Result.Add(Geometry);
+		}
+	}
+	return Result;
 }
 
 // The following need to be bound to delegate
@@ -36,82 +253,820 @@ void AGeometryHubActor::Tick(float DeltaTime)
 // We can change the signature of the delegate and explicitly indicate the signature ABaseGeometryActor.
 void AGeometryHubActor::OnColorChanged(const FLinearColor& Color, const FString& Name)
 {
-	UE_LOG(LogGeometryHub, Warning, TEXT("Actor name: %s Color %s"), *Name, *Color.ToString());
+	UE_LOG(LogGeometryHub, Verbose, TEXT("Actor name: %s Color %s"), *Name, *Color.ToString());
 }
 
 // The following need to be bound to delegate
 void AGeometryHubActor::OnTimerFinished(AActor* Actor)
 {
 	if (!Actor) return;
-	UE_LOG(LogGeometryHub, Error, TEXT("Timer finished: %s"), *Actor->GetName());
+	UE_LOG(LogGeometryHub, Verbose, TEXT("Timer finished: %s"), *Actor->GetName());
 
 	ABaseGeometryActor* Geometry = Cast<ABaseGeometryActor>(Actor);
 
 	if (!Geometry) return;
-	UE_LOG(LogGeometryHub, Display, TEXT("Cast is success, amplitude %f"), Geometry->GetGeometryData().Amplitude);
-	Geometry->Destroy();
+	// Already released, e.g. with its cell, by the time the queued event arrives
+	if (!SpatialIndex.Contains(Geometry)) return;
+	UntrackGeometry(Geometry);
+	RemoveStreamedActor(Geometry);
+	UE_LOG(LogGeometryHub, Verbose, TEXT("Cast is success, amplitude %f"), Geometry->GetGeometryData().Amplitude);
+
+	RetireGeometry(Geometry);
 	// Geometry->SetLifeSpan(2.0f);
 }
 
+// All the events of the frame in one call: a single log line instead of one formatted string per event
+void AGeometryHubActor::OnGeometryEvents(TConstArrayView<FGeometryEvent> Events)
+{
+	SCOPE_CYCLE_COUNTER(STAT_GeometryHubEvents);
+	TRACE_CPUPROFILER_EVENT_SCOPE(AGeometryHubActor::OnGeometryEvents);
+
+	int32 NumColorChanges = 0;
+	for (const FGeometryEvent& Event : Events)
+	{
+		switch (Event.Type)
+		{
+		case EGeometryEventType::ColorChanged: ++NumColorChanges;
+			ReplicatedGeometry.SetColor(Event.Actor.Get(), Event.Color);
+			break;
+
+		case EGeometryEventType::TimerFinished: OnTimerFinished(Event.Actor.Get());
+			break;
+
+		default: break;
+		}
+	}
+
+	UE_LOG(LogGeometryHub, Verbose, TEXT("%d geometry events, %d color changes"), Events.Num(), NumColorChanges);
+}
+
 void AGeometryHubActor::DoActorSpawn()
+{
+	SCOPE_CYCLE_COUNTER(STAT_GeometryDoActorSpawn);
+	TRACE_CPUPROFILER_EVENT_SCOPE(AGeometryHubActor::DoActorSpawn);
+
+	if (!GetWorld())
+		return;
+
+	// The demo shapes and the prewarm are spawned within the budget too, see SpawnPayloadsWithinBudget
+	if (bTimeSlicedSpawning)
+	{
+		StartPayloadSpawning();
+		return;
+	}
+
+	for (int32 Index = 0; Index < NumDemoActors; ++Index)
+	{
+		SpawnDemoActor(Index);
+	}
+
+	ResolveLayoutClasses();
+
+	if (ActorPool)
+	{
+		PrewarmPool();
+	}
+
+	const int32 NumItems = GetNumSpawnItems();
+	for (int32 Index = 0; Index < NumItems; ++Index)
+	{
+		SpawnItem(Index);
+	}
+	// The streamed layout records are read again whenever their cell is loaded
+	if (StreamingCells.Num() == 0)
+	{
+		CloseLayout();
+	}
+	OnSpawnCompleted.Broadcast(NumItems);
+}
+
+void AGeometryHubActor::SpawnDemoActor(int32 Index)
 {
 	// returns a pointer to the global game world object
 	UWorld* World = GetWorld();
 
-	if (World)
+	const int32 RowSize = NumDemoActors / 2;
+	if (Index < RowSize)
 	{
-		for (int32 i = 0; i < 10; ++i)
+		const FTransform GeometryTransform = FTransform(FRotator::ZeroRotator, FVector(0.0f, 300.0f * Index, 330.0f));
+		// para1: specify the class of the actor that we want to spawn
+		// para2: location
+		// para3: rotation
+		// para4: FActorSpawnParameters - specifies additional spawn settings
+
+		// World->SpawnActor<>():
+		// World->SpawnActor<>()是一个模板函数，用于在游戏世界中生成一个新的actor。
+		// 这个函数是UWorld类的一个成员函数，它负责在游戏中创建和管理actor。
+
+		// 模板参数:
+		// <ABaseGeometryActor>: 这个模板参数告诉SpawnActor函数想要生成的actor的类型。
+		// 在这个例子中，它指定了ABaseGeometryActor，这意味着生成的actor将是ABaseGeometryActor类型或其子类的实例。
+		ABaseGeometryActor* Geometry = World->SpawnActor<ABaseGeometryActor>(GeometryClass, GeometryTransform);
+
+		if (Geometry)
 		{
-			const FTransform GeometryTransform = FTransform(FRotator::ZeroRotator, FVector(0.0f, 300.0f * i, 330.0f));
-			// para1: specify the class of the actor that we want to spawn
-			// para2: location
-			// para3: rotation
-			// para4: FActorSpawnParameters - specifies additional spawn settings
+			FGeometryData Data;
+			Data.MoveType = RandomStream.NextBool() ? EMovementType::Static : EMovementType::Sin;
+			Geometry->SetGeometryData(Data);
+			Geometry->SetRandomKey(MakeRandomKey(-1 - Index));
+			// SpawnActor has already run BeginPlay with the default data, so how the shape moves depends on the movement
+			// path it registered with. A client copy spawned from GetGeometryData wouldn't match it: this row stays on the
+			// server and isn't added to ReplicatedGeometry.
+			SpatialIndex.Add(Geometry, GeometryMovement::IsMoving(Data.MoveType));
+		}
+		return;
+	}
 
-			// World->SpawnActor<>():
-			// World->SpawnActor<>()是一个模板函数，用于在游戏世界中生成一个新的actor。
-			// 这个函数是UWorld类的一个成员函数，它负责在游戏中创建和管理actor。
+	const FTransform GeometryTransform = FTransform(FRotator::ZeroRotator, FVector(0.0f, 300.0f * (Index - RowSize), 700.0f));
+	ABaseGeometryActor* Geometry = World->SpawnActorDeferred<ABaseGeometryActor>(
+		GeometryClass, GeometryTransform);
+
+	if (Geometry)
+	{
+		FGeometryData Data;
+		Data.Color = RandomStream.NextColor();
+		Geometry->SetGeometryData(Data);
+		Geometry->SetRandomKey(MakeRandomKey(-1 - Index));
+		Geometry->FinishSpawning(GeometryTransform);
+		TrackGeometry(Geometry);
+	}
+}
 
-			// 模板参数:
-			// <ABaseGeometryActor>: 这个模板参数告诉SpawnActor函数想要生成的actor的类型。
-			// 在这个例子中，它指定了ABaseGeometryActor，这意味着生成的actor将是ABaseGeometryActor类型或其子类的实例。
-			ABaseGeometryActor* Geometry = World->SpawnActor<ABaseGeometryActor>(GeometryClass, GeometryTransform);
+void AGeometryHubActor::StartPayloadSpawning()
+{
+	TArray<FSoftObjectPath> ClassPaths;
+	for (const FGeometryPayload& Payload : GeometryPayloads)
+	{
+		if (!Payload.GeometryClass && Payload.SoftGeometryClass.IsPending())
+		{
+			ClassPaths.AddUnique(Payload.SoftGeometryClass.ToSoftObjectPath());
+		}
+	}
 
-			if (Geometry)
+	if (Layout)
+	{
+		for (const FSoftObjectPath& LayoutClassPath : Layout->GetClassPaths())
+		{
+			if (!LayoutClassPath.ResolveObject())
 			{
-				FGeometryData Data;
-				Data.MoveType = FMath::RandBool() ? EMovementType::Static : EMovementType::Sin;
-				Geometry->SetGeometryData(Data);
+				ClassPaths.AddUnique(LayoutClassPath);
 			}
 		}
+	}
+
+	if (ClassPaths.Num() == 0)
+	{
+		OnPayloadClassesLoaded();
+		return;
+	}
 
-		for (int32 i = 0; i < 10; ++i)
+	// Nothing is spawned before all the classes are in memory, so the spawning itself never blocks on a load
+	PayloadClassesHandle = UAssetManager::GetStreamableManager().RequestAsyncLoad(
+		ClassPaths, FStreamableDelegate::CreateUObject(this, &AGeometryHubActor::OnPayloadClassesLoaded));
+}
+
+void AGeometryHubActor::OnPayloadClassesLoaded()
+{
+	ResolveLayoutClasses();
+
+	NextDemoIndex = 0;
+	QueuePoolPrewarm();
+	NextPayloadIndex = 0;
+}
+
+void AGeometryHubActor::SpawnPayloadsWithinBudget()
+{
+	SCOPE_CYCLE_COUNTER(STAT_GeometrySpawnWithinBudget);
+	TRACE_CPUPROFILER_EVENT_SCOPE(AGeometryHubActor::SpawnPayloadsWithinBudget);
+
+	const double EndTime = FPlatformTime::Seconds() + SpawnBudgetMs / 1000.0;
+
+	const int32 NumItems = GetNumSpawnItems();
+
+	// At least one step per frame, so a tiny budget can't stall the spawning
+	bool bFinished = false;
+	do
+	{
+		if (NextDemoIndex < NumDemoActors)
 		{
-			const FTransform GeometryTransform = FTransform(FRotator::ZeroRotator, FVector(0.0f, 300.0f * i, 700.0f));
-			ABaseGeometryActor* Geometry = World->SpawnActorDeferred<ABaseGeometryActor>(
-				GeometryClass, GeometryTransform);
+			SpawnDemoActor(NextDemoIndex++);
+		}
+		else if (PendingPrewarm.Num() > 0)
+		{
+			TPair<TSubclassOf<ABaseGeometryActor>, int32>& Prewarm = PendingPrewarm.Last();
+			ActorPool->Prewarm(Prewarm.Key, 1);
+			if (--Prewarm.Value == 0)
+			{
+				PendingPrewarm.Pop(false);
+			}
+		}
+		else if (NextPayloadIndex < NumItems)
+		{
+			SpawnItem(NextPayloadIndex++);
+		}
+		else
+		{
+			bFinished = true;
+		}
+	}
+	while (!bFinished && FPlatformTime::Seconds() < EndTime);
 
-			if (Geometry)
+	if (bFinished || (NextDemoIndex >= NumDemoActors && PendingPrewarm.Num() == 0 && NextPayloadIndex >= NumItems))
+	{
+		NextPayloadIndex = INDEX_NONE;
+		PayloadClassesHandle.Reset();
+		if (StreamingCells.Num() == 0)
+		{
+			CloseLayout();
+		}
+		OnSpawnCompleted.Broadcast(NumItems);
+	}
+}
+
+void AGeometryHubActor::OpenLayout()
+{
+	if (LayoutFile.FilePath.IsEmpty())
+		return;
+
+	Layout = MakeUnique<FGeometryLayoutReader>();
+	if (!Layout->Open(FPaths::ConvertRelativePathToFull(FPaths::ProjectDir(), LayoutFile.FilePath)))
+	{
+		Layout.Reset();
+	}
+}
+
+void AGeometryHubActor::ResolveLayoutClasses()
+{
+	LayoutClasses.Reset();
+	if (!Layout)
+		return;
+
+	// Already loaded by the time-sliced spawning, otherwise loaded on the spot
+	for (const FSoftObjectPath& LayoutClassPath : Layout->GetClassPaths())
+	{
+		LayoutClasses.Add(TSoftClassPtr<ABaseGeometryActor>(LayoutClassPath).LoadSynchronous());
+	}
+}
+
+void AGeometryHubActor::CloseLayout()
+{
+	// Unmaps the file, the records are not needed after spawning
+	Layout.Reset();
+	LayoutClasses.Reset();
+}
+
+int32 AGeometryHubActor::GetNumSpawnItems() const
+{
+	return GeometryPayloads.Num() + (Layout ? Layout->Num() : 0);
+}
+
+void AGeometryHubActor::SpawnItem(int32 Index)
+{
+	if (IsStreamedItem(Index))
+	{
+		// Spawned by UpdateStreamingCells once a player pawn is near
+		const FVector Location = GetSpawnItemLocation(Index);
+		const FIntPoint CellKey(FMath::FloorToInt(Location.X / StreamingCellSize), FMath::FloorToInt(Location.Y / StreamingCellSize));
+		StreamingCells.FindOrAdd(CellKey).Items.Add(Index);
+		return;
+	}
+
+	SpawnItemGeometry(Index);
+}
+
+ABaseGeometryActor* AGeometryHubActor::SpawnItemGeometry(int32 Index)
+{
+	if (Index < GeometryPayloads.Num())
+		return SpawnPayload(GeometryPayloads[Index], Index);
+
+	const FGeometryLayoutRecord& Record = Layout->GetRecord(Index - GeometryPayloads.Num());
+	if (!Record.IsValid(LayoutClasses.Num()))
+	{
+		UE_LOG(LogGeometryHub, Warning, TEXT("Layout record %d has class index %u and flags %u, not spawned"), Index - GeometryPayloads.Num(),
+		       Record.ClassIndex, Record.Data.Flags);
+		return nullptr;
+	}
+	if (!LayoutClasses[Record.ClassIndex])
+		return nullptr;
+
+	return SpawnGeometry(LayoutClasses[Record.ClassIndex], Record.GetTransform(), Record.GetData(), LayoutBackend, Index);
+}
+
+bool AGeometryHubActor::IsStreamedItem(int32 Index) const
+{
+	// Instances and Mass entities are cheap enough to stay resident
+	if (!bStreamPayloadCells || bUseInstancedRendering)
+		return false;
+
+	const EGeometryBackend Backend = Index < GeometryPayloads.Num() ? GeometryPayloads[Index].Backend : LayoutBackend;
+	return Backend == EGeometryBackend::Actor;
+}
+
+FVector AGeometryHubActor::GetSpawnItemLocation(int32 Index) const
+{
+	if (Index < GeometryPayloads.Num())
+		return GeometryPayloads[Index].InitialTransform.GetLocation();
+
+	return Layout->GetRecord(Index - GeometryPayloads.Num()).GetTransform().GetLocation();
+}
+
+void AGeometryHubActor::UpdateStreamingCells()
+{
+	SCOPE_CYCLE_COUNTER(STAT_GeometryStreamingUpdate);
+	TRACE_CPUPROFILER_EVENT_SCOPE(AGeometryHubActor::UpdateStreamingCells);
+
+	// Every player on a server, the local players on a client
+	TGeometryFrameArray<FVector2D> Viewers;
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		const APlayerController* PlayerController = It->Get();
+		if (const APawn* Pawn = PlayerController ? PlayerController->GetPawn() : nullptr)
+		{
+			Viewers.Add(FVector2D(Pawn->GetActorLocation()));
+		}
+	}
+
+	// Nothing changes while no pawn is possessed, e.g. between death and respawn
+	if (Viewers.Num() == 0)
+		return;
+
+	const double InRadiusSquared = FMath::Square(static_cast<double>(StreamInRadius));
+	const double OutRadiusSquared = FMath::Square(static_cast<double>(FMath::Max(StreamOutRadius, StreamInRadius)));
+
+	const auto GetDistanceSquared = [this, &Viewers](const FIntPoint& CellKey)
+	{
+		const FVector2D CellMin = FVector2D(CellKey) * StreamingCellSize;
+		const FBox2D CellBounds(CellMin, CellMin + FVector2D(StreamingCellSize));
+
+		double DistanceSquared = TNumericLimits<double>::Max();
+		for (const FVector2D& Viewer : Viewers)
+		{
+			DistanceSquared = FMath::Min(DistanceSquared, CellBounds.ComputeSquaredDistanceToPoint(Viewer));
+		}
+		return DistanceSquared;
+	};
+
+	for (int32 Index = LoadedCellKeys.Num() - 1; Index >= 0; --Index)
+	{
+		if (GetDistanceSquared(LoadedCellKeys[Index]) > OutRadiusSquared)
+		{
+			UnloadStreamingCell(StreamingCells.FindChecked(LoadedCellKeys[Index]));
+			LoadedCellKeys.RemoveAtSwap(Index, 1, false);
+		}
+	}
+
+	const auto TryLoad = [this, &GetDistanceSquared, InRadiusSquared](const FIntPoint& CellKey, FGeometryStreamingCell& Cell)
+	{
+		if (!Cell.bLoaded && GetDistanceSquared(CellKey) <= InRadiusSquared)
+		{
+			LoadStreamingCell(CellKey, Cell);
+		}
+	};
+
+	// Only the cells within StreamInRadius of a pawn can load, unless the hub has fewer cells than that
+	const int32 CellRadius = FMath::CeilToInt(StreamInRadius / StreamingCellSize);
+	const int64 NumNearCells = Viewers.Num() * FMath::Square(2 * static_cast<int64>(CellRadius) + 1);
+	if (NumNearCells < StreamingCells.Num())
+	{
+		for (const FVector2D& Viewer : Viewers)
+		{
+			const FIntPoint Center(FMath::FloorToInt(Viewer.X / StreamingCellSize), FMath::FloorToInt(Viewer.Y / StreamingCellSize));
+			for (int32 Y = Center.Y - CellRadius; Y <= Center.Y + CellRadius; ++Y)
 			{
-				FGeometryData Data;
-				Data.Color = FLinearColor::MakeRandomColor();
-				Geometry->SetGeometryData(Data);
-				Geometry->FinishSpawning(GeometryTransform);
+				for (int32 X = Center.X - CellRadius; X <= Center.X + CellRadius; ++X)
+				{
+					const FIntPoint CellKey(X, Y);
+					if (FGeometryStreamingCell* Cell = StreamingCells.Find(CellKey))
+					{
+						TryLoad(CellKey, *Cell);
+					}
+				}
 			}
 		}
+	}
+	else
+	{
+		for (TPair<FIntPoint, FGeometryStreamingCell>& Pair : StreamingCells)
+		{
+			TryLoad(Pair.Key, Pair.Value);
+		}
+	}
+
+	SET_DWORD_STAT(STAT_GeometryLoadedStreamingCells, LoadedCellKeys.Num());
+}
 
-		for (const FGeometryPayload& Payload : GeometryPayloads)
+void AGeometryHubActor::LoadStreamingCell(const FIntPoint& CellKey, FGeometryStreamingCell& Cell)
+{
+	INC_DWORD_STAT(STAT_GeometryStreamingCellLoads);
+
+	Cell.bLoaded = true;
+	Cell.Actors.Reset(Cell.Items.Num());
+	LoadedCellKeys.Add(CellKey);
+
+	// Released and loaded again before its items were spawned: the queue still has it
+	if (!Cell.bSpawnQueued && Cell.Items.Num() > 0)
+	{
+		Cell.bSpawnQueued = true;
+		PendingCellSpawns.Add(CellKey);
+	}
+}
+
+void AGeometryHubActor::UnloadStreamingCell(FGeometryStreamingCell& Cell)
+{
+	INC_DWORD_STAT(STAT_GeometryStreamingCellUnloads);
+
+	for (const TWeakObjectPtr<ABaseGeometryActor>& Actor : Cell.Actors)
+	{
+		if (ABaseGeometryActor* Geometry = Actor.Get())
 		{
-			ABaseGeometryActor* Geometry = World->SpawnActorDeferred<ABaseGeometryActor>(
-				Payload.GeometryClass, Payload.InitialTransform);
+			StreamedActorCells.Remove(Geometry);
+			UntrackGeometry(Geometry);
+			RetireGeometry(Geometry);
+		}
+	}
+	Cell.Actors.Reset();
+	Cell.bLoaded = false;
+}
+
+void AGeometryHubActor::SpawnStreamedItemsWithinBudget()
+{
+	SCOPE_CYCLE_COUNTER(STAT_GeometryStreamingSpawn);
+	TRACE_CPUPROFILER_EVENT_SCOPE(AGeometryHubActor::SpawnStreamedItemsWithinBudget);
+
+	const double EndTime = FPlatformTime::Seconds() + StreamingSpawnBudgetMs / 1000.0;
 
+	// Cells before the head are done, they are removed in one go at the end
+	int32 Head = 0;
+
+	// At least one actor per frame, so a tiny budget can't stall the loading
+	do
+	{
+		const FIntPoint CellKey = PendingCellSpawns[Head];
+		FGeometryStreamingCell& Cell = StreamingCells.FindChecked(CellKey);
+		if (Cell.bLoaded && Cell.Actors.Num() < Cell.Items.Num())
+		{
+			// Taken from the pool when there is one, so a pawn walking around reuses the actors of the cells behind it
+			ABaseGeometryActor* Geometry = SpawnItemGeometry(Cell.Items[Cell.Actors.Num()]);
+			Cell.Actors.Add(Geometry);
 			if (Geometry)
 			{
-				Geometry->SetGeometryData(Payload.Data);
-				Geometry->OnColorChanged.AddDynamic(this, &AGeometryHubActor::OnColorChanged);
-				Geometry->OnTimerFinished.AddUObject(this, &AGeometryHubActor::OnTimerFinished);
-				Geometry->FinishSpawning(Payload.InitialTransform);
+				StreamedActorCells.Add(Geometry, CellKey);
 			}
 		}
+
+		if (!Cell.bLoaded || Cell.Actors.Num() >= Cell.Items.Num())
+		{
+			Cell.bSpawnQueued = false;
+			++Head;
+		}
+	}
+	while (Head < PendingCellSpawns.Num() && FPlatformTime::Seconds() < EndTime);
+
+	// One shift for all the cells finished this frame instead of one per cell
+	PendingCellSpawns.RemoveAt(0, Head, false);
+}
+
+void AGeometryHubActor::RemoveStreamedActor(ABaseGeometryActor* Geometry)
+{
+	FIntPoint CellKey;
+	if (!StreamedActorCells.RemoveAndCopyValue(Geometry, CellKey))
+		return;
+
+	FGeometryStreamingCell& Cell = StreamingCells.FindChecked(CellKey);
+	const int32 ActorIndex = Cell.Actors.IndexOfByKey(Geometry);
+	if (ActorIndex != INDEX_NONE)
+	{
+		// The last spawned item takes the free slot and the last item the one it left, the items still to spawn stay after the actors
+		const int32 LastSpawned = Cell.Actors.Num() - 1;
+		Cell.Items[ActorIndex] = Cell.Items[LastSpawned];
+		Cell.Actors.RemoveAtSwap(ActorIndex, 1, false);
+		Cell.Items.RemoveAtSwap(LastSpawned, 1, false);
+	}
+}
+
+TSubclassOf<ABaseGeometryActor> AGeometryHubActor::ResolvePayloadClass(const FGeometryPayload& Payload) const
+{
+	if (Payload.GeometryClass)
+		return Payload.GeometryClass;
+
+	// Already loaded by the time-sliced spawning, otherwise loaded on the spot
+	return Payload.SoftGeometryClass.LoadSynchronous();
+}
+
+void AGeometryHubActor::QueuePoolPrewarm()
+{
+	PendingPrewarm.Reset();
+	if (!ActorPool || PoolPrewarmCount <= 0)
+		return;
+
+	TSet<TSubclassOf<ABaseGeometryActor>> Classes;
+	for (const FGeometryPayload& Payload : GeometryPayloads)
+	{
+		Classes.Add(ResolvePayloadClass(Payload));
+	}
+	Classes.Append(LayoutClasses);
+
+	for (const TSubclassOf<ABaseGeometryActor>& PayloadClass : Classes)
+	{
+		if (PayloadClass)
+		{
+			PendingPrewarm.Emplace(PayloadClass, PoolPrewarmCount);
+		}
 	}
 }
+
+void AGeometryHubActor::PrewarmPool()
+{
+	QueuePoolPrewarm();
+	for (const TPair<TSubclassOf<ABaseGeometryActor>, int32>& Prewarm : PendingPrewarm)
+	{
+		ActorPool->Prewarm(Prewarm.Key, Prewarm.Value);
+	}
+	PendingPrewarm.Reset();
+}
+
+ABaseGeometryActor* AGeometryHubActor::SpawnPayload(const FGeometryPayload& Payload, int32 SpawnIndex)
+{
+	return SpawnGeometry(ResolvePayloadClass(Payload), Payload.InitialTransform, Payload.Data, Payload.Backend, SpawnIndex);
+}
+
+uint64 AGeometryHubActor::MakeRandomKey(int32 SpawnIndex) const
+{
+	return (static_cast<uint64>(GetTypeHash(GetFName())) << 32) | static_cast<uint32>(SpawnIndex);
+}
+
+ABaseGeometryActor* AGeometryHubActor::SpawnGeometry(TSubclassOf<ABaseGeometryActor> PayloadClass, const FTransform& Transform, const FGeometryData& Data,
+                                                     EGeometryBackend Backend, int32 SpawnIndex)
+{
+	if (!PayloadClass)
+		return nullptr;
+
+	if (Backend == EGeometryBackend::MassEntity && InstanceRenderer)
+	{
+		// No actor at all until PromoteMassGeometryInSphere asks for one
+		if (UGeometryMassSubsystem* MassSubsystem = GetWorld()->GetSubsystem<UGeometryMassSubsystem>())
+		{
+			MassSubsystem->SpawnEntity(InstanceRenderer, PayloadClass, Transform, Data);
+		}
+		return nullptr;
+	}
+
+	if (bUseInstancedRendering && InstanceRenderer)
+	{
+		InstanceRenderer->AddInstance(PayloadClass, Transform, Data);
+		return nullptr;
+	}
+
+	ABaseGeometryActor* Geometry = nullptr;
+
+	if (ActorPool)
+	{
+		// The pooled actor is already in play, the handlers are bound before its first timer can fire
+		Geometry = ActorPool->Acquire(PayloadClass, Transform, Data);
+		if (Geometry)
+		{
+			Geometry->SetRandomKey(MakeRandomKey(SpawnIndex));
+			BindGeometry(Geometry);
+			TrackGeometry(Geometry);
+		}
+		return Geometry;
+	}
+
+	Geometry = GetWorld()->SpawnActorDeferred<ABaseGeometryActor>(PayloadClass, Transform);
+
+	if (Geometry)
+	{
+		Geometry->SetGeometryData(Data);
+		Geometry->SetRandomKey(MakeRandomKey(SpawnIndex));
+		BindGeometry(Geometry);
+		Geometry->FinishSpawning(Transform);
+		TrackGeometry(Geometry);
+	}
+	return Geometry;
+}
+
+void AGeometryHubActor::BindGeometry(ABaseGeometryActor* Geometry)
+{
+	if (bUseEventQueue || IsReplicatingGeometry())
+	{
+		// The events arrive once per frame in OnGeometryEvents, no delegate is bound per actor
+		Geometry->SetUseEventQueue(true);
+		return;
+	}
+
+	Geometry->OnColorChanged.AddDynamic(this, &AGeometryHubActor::OnColorChanged);
+	Geometry->OnTimerFinished.AddUObject(this, &AGeometryHubActor::OnTimerFinished);
+}
+
+void AGeometryHubActor::TrackGeometry(ABaseGeometryActor* Geometry)
+{
+	SpatialIndex.Add(Geometry, GeometryMovement::IsMoving(Geometry->GetGeometryData().MoveType));
+
+	if (IsReplicatingGeometry())
+	{
+		// The color changes reach ReplicatedGeometry through OnGeometryEvents
+		Geometry->SetUseEventQueue(true);
+		ReplicatedGeometry.Add(Geometry);
+	}
+}
+
+void AGeometryHubActor::UntrackGeometry(ABaseGeometryActor* Geometry)
+{
+	SpatialIndex.Remove(Geometry);
+	ReplicatedGeometry.Remove(Geometry);
+}
+
+bool AGeometryHubActor::IsReplicatingGeometry() const
+{
+	const ENetMode NetMode = GetNetMode();
+	return bReplicateGeometry && (NetMode == NM_ListenServer || NetMode == NM_DedicatedServer);
+}
+
+void AGeometryHubActor::SpawnReplicatedGeometry(FGeometryReplicatedItem& Item)
+{
+	if (!Item.GeometryClass)
+		return;
+
+	const FTransform Transform = Item.GetTransform();
+	ABaseGeometryActor* Geometry = GetWorld()->SpawnActorDeferred<ABaseGeometryActor>(Item.GeometryClass, Transform);
+	if (!Geometry)
+		return;
+
+	// The copy has no timer of its own: the server sends its colors and removes the shape when its timer finishes
+	Geometry->SetGeometryData(Item.Data.Unpack());
+	Geometry->SetDrivenByReplication(true);
+	Geometry->FinishSpawning(Transform);
+
+	SpatialIndex.Add(Geometry, GeometryMovement::IsMoving(Item.Data.GetMoveType()));
+	Item.Actor = Geometry;
+}
+
+void AGeometryHubActor::DestroyReplicatedGeometry(ABaseGeometryActor* Geometry)
+{
+	if (!Geometry)
+		return;
+
+	SpatialIndex.Remove(Geometry);
+	// The copy never came from the pool, a released one would stay in it for good
+	DestroyGeometry(Geometry);
+}
+
+void AGeometryHubActor::RetireGeometry(ABaseGeometryActor* Geometry)
+{
+	// Deactivating is all the pool does, there is nothing left to spread over frames.
+	// Actors the pool didn't spawn, e.g. the ones promoted from Mass entities, are destroyed.
+	if (ActorPool && ActorPool->Release(Geometry))
+		return;
+
+	DestroyGeometry(Geometry);
+}
+
+void AGeometryHubActor::DestroyGeometry(ABaseGeometryActor* Geometry)
+{
+	if (!bDeferredRetirement)
+	{
+		Geometry->Destroy();
+		return;
+	}
+
+	// Gone for the player from now on, the destruction with its component unregistration waits for RetireWithinBudget
+	Geometry->DeactivateGeometry();
+	RetireQueue.Add(Geometry);
+	SET_DWORD_STAT(STAT_GeometryRetireQueue, RetireQueue.Num() - RetireQueueHead);
+}
+
+void AGeometryHubActor::RetireWithinBudget()
+{
+	SCOPE_CYCLE_COUNTER(STAT_GeometryRetireWithinBudget);
+	TRACE_CPUPROFILER_EVENT_SCOPE(AGeometryHubActor::RetireWithinBudget);
+
+	const double StartTime = FPlatformTime::Seconds();
+	const double EndTime = StartTime + RetireBudgetMs / 1000.0;
+
+	// At least one actor per frame, so a tiny budget can't grow the queue forever
+	int32 NumRetired = 0;
+	double Now = StartTime;
+	double SlowestActorSeconds = 0.0;
+	do
+	{
+		const double ActorStartTime = Now;
+		ABaseGeometryActor* Geometry = RetireQueue[RetireQueueHead];
+		if (IsValid(Geometry))
+		{
+			Geometry->Destroy();
+		}
+		RetireQueue[RetireQueueHead++] = nullptr;
+		++NumRetired;
+		Now = FPlatformTime::Seconds();
+		SlowestActorSeconds = FMath::Max(SlowestActorSeconds, Now - ActorStartTime);
+	}
+	while (RetireQueueHead < RetireQueue.Num() && Now < EndTime);
+
+	INC_DWORD_STAT_BY(STAT_GeometryRetiredActors, NumRetired);
+	LastRetireMs = (Now - StartTime) * 1000.0;
+	LastRetireSlowestActorMs = SlowestActorSeconds * 1000.0;
+
+	// The slots before the head are only dropped once the queue is empty, so adding never shifts the array
+	if (RetireQueueHead >= RetireQueue.Num())
+	{
+		RetireQueue.Reset();
+		RetireQueueHead = 0;
+	}
+	SET_DWORD_STAT(STAT_GeometryRetireQueue, RetireQueue.Num() - RetireQueueHead);
+}
+
+void AGeometryHubActor::FlushRetireQueue()
+{
+	for (int32 i = RetireQueueHead; i < RetireQueue.Num(); ++i)
+	{
+		if (IsValid(RetireQueue[i]))
+		{
+			RetireQueue[i]->Destroy();
+		}
+	}
+	RetireQueue.Reset();
+	RetireQueueHead = 0;
+	SET_DWORD_STAT(STAT_GeometryRetireQueue, 0);
+}
+
+void AGeometryHubActor::UpdateReplicationBandwidth()
+{
+	const double Now = FPlatformTime::Seconds();
+	const double Elapsed = Now - BandwidthWindowStart;
+	if (Elapsed < 1.0)
+		return;
+
+	ReplicationBytesPerSecond = static_cast<float>(ReplicatedGeometry.ConsumeNumSerializedBits() / 8.0 / Elapsed);
+	BandwidthWindowStart = Now;
+
+	const bool bClient = GetNetMode() == NM_Client;
+	if (bClient)
+	{
+		SET_DWORD_STAT(STAT_GeometryReplicationBytesReceived, FMath::RoundToInt(ReplicationBytesPerSecond));
+	}
+	else
+	{
+		SET_DWORD_STAT(STAT_GeometryReplicationBytesSent, FMath::RoundToInt(ReplicationBytesPerSecond));
+	}
+
+	if (CVarGeometryLogReplicationBandwidth.GetValueOnGameThread())
+	{
+		UE_LOG(LogGeometryHub, Display, TEXT("%s: %.1f KB/s %s, %d shapes"), *GetName(), ReplicationBytesPerSecond / 1024.0f,
+		       bClient ? TEXT("received") : TEXT("sent"), ReplicatedGeometry.Num());
+	}
+}
+
+// Compares the spatial index of the first hub with a TActorIterator scan over all geometry actors.
+// Usage: geometry.Spatial.Benchmark [Radius] [NumQueries]
+static FAutoConsoleCommandWithWorldAndArgs GGeometrySpatialBenchmarkCommand(
+	TEXT("geometry.Spatial.Benchmark"),
+	TEXT("Compares QueryGeometryInSphere with a TActorIterator scan."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		TActorIterator<AGeometryHubActor> HubIt(World);
+		if (!World || !HubIt)
+			return;
+
+		const AGeometryHubActor* Hub = *HubIt;
+		const float Radius = Args.Num() > 0 ? FCString::Atof(*Args[0]) : 1000.0f;
+		const int32 NumQueries = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 1) : 100;
+
+		// Query centers around the existing geometry
+		TArray<FVector> Centers;
+		for (TActorIterator<ABaseGeometryActor> It(World); It && Centers.Num() < NumQueries; ++It)
+		{
+			Centers.Add(It->GetActorLocation());
+		}
+		if (Centers.Num() == 0)
+			return;
+
+		TArray<ABaseGeometryActor*> Result;
+		int32 NumIndexResults = 0;
+		double StartTime = FPlatformTime::Seconds();
+		for (const FVector& Center : Centers)
+		{
+			Result.Reset();
+			Hub->CollectGeometryInSphere(Center, Radius, Result);
+			NumIndexResults += Result.Num();
+		}
+		const double IndexSeconds = FPlatformTime::Seconds() - StartTime;
+
+		int32 NumIteratorResults = 0;
+		StartTime = FPlatformTime::Seconds();
+		for (const FVector& Center : Centers)
+		{
+			Result.Reset();
+			for (TActorIterator<ABaseGeometryActor> It(World); It; ++It)
+			{
+				if (FVector::DistSquared(It->GetActorLocation(), Center) <= FMath::Square(Radius))
+				{
+					Result.Add(*It);
+				}
+			}
+			NumIteratorResults += Result.Num();
+		}
+		const double IteratorSeconds = FPlatformTime::Seconds() - StartTime;
+
+		UE_LOG(LogGeometryHub, Display, TEXT("%d sphere queries, radius %.0f: index %.3f ms (%d hits), TActorIterator %.3f ms (%d hits)"), Centers.Num(), Radius,
+		       IndexSeconds * 1000.0, NumIndexResults, IteratorSeconds * 1000.0, NumIteratorResults);
+	}));
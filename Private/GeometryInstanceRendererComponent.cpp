@@ -0,0 +1,450 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GeometryInstanceRendererComponent.h"
+#include "GeometryMovementKernels.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogGeometryInstances, All, All)
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+UGeometryInstanceRendererComponent::UGeometryInstanceRendererComponent()
+{
+	// The tick is switched on by the first instance
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.bStartWithTickEnabled = false;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryInstanceRendererComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	ColorStream = GeometryRandom::MakeStream(GetTypeHash(GetPathName()));
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+FGeometryInstanceHandle UGeometryInstanceRendererComponent::AddInstance(TSubclassOf<ABaseGeometryActor> GeometryClass, const FTransform& Transform,
+                                                                        const FGeometryData& Data, bool bSimulate)
+{
+	FGeometryInstanceHandle Handle;
+
+	const int32 MeshIndex = FindOrAddMesh(GeometryClass);
+	if (MeshIndex == INDEX_NONE)
+		return Handle;
+
+	UInstancedStaticMeshComponent* Mesh = Meshes[MeshIndex];
+	const int32 InstanceIndex = Mesh->AddInstance(Transform, true);
+	MeshInstances[MeshIndex].Transforms.Add(Transform);
+
+	Handle.Index = InstanceMeshes.Add(MeshIndex);
+	InstanceIndices.Add(InstanceIndex);
+	TimeRates.Add(Data.TimeRate);
+	TimerCounts.Add(0);
+
+	const bool bSin = Data.MoveType == EMovementType::Sin;
+	InstanceLocations.Add(Transform.GetLocation());
+	InstanceAmplitudes.Add(bSin ? Data.Amplitude : 0.0f);
+	InstanceFrequencies.Add(bSin ? Data.Frequency : 0.0f);
+	SinSlots.Add(INDEX_NONE);
+
+	const UWorld* World = GetWorld();
+	NextFireTimes.Add(bSimulate ? (World ? World->GetTimeSeconds() : 0.0f) + Data.TimeRate : TNumericLimits<float>::Max());
+
+	if (bSin && bSimulate && bUseGPUMovement)
+	{
+		// Written once, the instance transform never changes again
+		Mesh->SetCustomDataValue(InstanceIndex, AmplitudeCustomDataIndex, Data.Amplitude, false);
+		Mesh->SetCustomDataValue(InstanceIndex, FrequencyCustomDataIndex, Data.Frequency, false);
+
+		// The offset happens after culling, the bounds must cover the whole motion. Applied by FlushMeshUpdates, once for all the adds of the frame
+		const float Radius = Mesh->GetStaticMesh()->GetBounds().SphereRadius * Transform.GetMaximumAxisScale();
+		if (Radius > KINDA_SMALL_NUMBER)
+		{
+			float& RequiredBoundsScale = MeshInstances[MeshIndex].RequiredBoundsScale;
+			RequiredBoundsScale = FMath::Max(RequiredBoundsScale, (Radius + FMath::Abs(Data.Amplitude)) / Radius);
+		}
+	}
+	else if (bSin && bSimulate)
+	{
+		SinSlots[Handle.Index] = SinInstances.Add(Handle.Index);
+		InitialTransforms.Add(Transform);
+		Amplitudes.Add(Data.Amplitude);
+		Frequencies.Add(Data.Frequency);
+	}
+
+	SetInstanceColor(Handle, Data.Color);
+	// Also needed for instances driven by the caller, the tick flushes their changes to the meshes
+	SetComponentTickEnabled(true);
+
+	return Handle;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryInstanceRendererComponent::SetInstanceColor(FGeometryInstanceHandle Handle, const FLinearColor& Color)
+{
+	if (!InstanceMeshes.IsValidIndex(Handle.Index))
+		return;
+
+	const int32 MeshIndex = InstanceMeshes[Handle.Index];
+	const float ColorData[NumColorCustomData] = {Color.R, Color.G, Color.B, Color.A};
+
+	// Only the custom data changes, the mesh sends its instance data once per frame
+	Meshes[MeshIndex]->SetCustomData(InstanceIndices[Handle.Index], MakeArrayView(ColorData), false);
+	MeshInstances[MeshIndex].bCustomDataDirty = true;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryInstanceRendererComponent::SetInstanceTransform(FGeometryInstanceHandle Handle, const FTransform& Transform)
+{
+	if (!InstanceMeshes.IsValidIndex(Handle.Index))
+		return;
+
+	FMeshInstances& Instances = MeshInstances[InstanceMeshes[Handle.Index]];
+	const int32 InstanceIndex = InstanceIndices[Handle.Index];
+	Instances.Transforms[InstanceIndex] = Transform;
+	Instances.MarkTransformDirty(InstanceIndex);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryInstanceRendererComponent::RemoveInstance(FGeometryInstanceHandle Handle)
+{
+	if (!InstanceMeshes.IsValidIndex(Handle.Index))
+		return;
+
+	HideInstance(Handle.Index);
+	NextFireTimes[Handle.Index] = TNumericLimits<float>::Max();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryInstanceRendererComponent::SetInstanceTransforms(TConstArrayView<FGeometryInstanceHandle> Handles, TConstArrayView<FTransform> Transforms)
+{
+	check(Handles.Num() == Transforms.Num());
+
+	int32 MeshIndex = INDEX_NONE;
+	FMeshInstances* Instances = nullptr;
+	for (int32 i = 0; i < Handles.Num(); ++i)
+	{
+		const int32 Index = Handles[i].Index;
+		if (!InstanceMeshes.IsValidIndex(Index))
+			continue;
+
+		if (InstanceMeshes[Index] != MeshIndex)
+		{
+			MeshIndex = InstanceMeshes[Index];
+			Instances = &MeshInstances[MeshIndex];
+		}
+
+		const int32 InstanceIndex = InstanceIndices[Index];
+		Instances->Transforms[InstanceIndex] = Transforms[i];
+		Instances->MarkTransformDirty(InstanceIndex);
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryInstanceRendererComponent::SetInstanceColors(TConstArrayView<FGeometryInstanceHandle> Handles, TConstArrayView<FLinearColor> Colors)
+{
+	check(Handles.Num() == Colors.Num());
+
+	int32 MeshIndex = INDEX_NONE;
+	UInstancedStaticMeshComponent* Mesh = nullptr;
+	for (int32 i = 0; i < Handles.Num(); ++i)
+	{
+		const int32 Index = Handles[i].Index;
+		if (!InstanceMeshes.IsValidIndex(Index))
+			continue;
+
+		if (InstanceMeshes[Index] != MeshIndex)
+		{
+			MeshIndex = InstanceMeshes[Index];
+			Mesh = Meshes[MeshIndex];
+			MeshInstances[MeshIndex].bCustomDataDirty = true;
+		}
+
+		// The mesh has no batch form for the custom data, but nothing is sent before FlushMeshUpdates
+		const FLinearColor& Color = Colors[i];
+		const float ColorData[NumColorCustomData] = {Color.R, Color.G, Color.B, Color.A};
+		Mesh->SetCustomData(InstanceIndices[Index], MakeArrayView(ColorData), false);
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryInstanceRendererComponent::RemoveInstances(TConstArrayView<FGeometryInstanceHandle> Handles)
+{
+	for (const FGeometryInstanceHandle Handle : Handles)
+	{
+		RemoveInstance(Handle);
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryInstanceRendererComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	const float Time = GetWorld()->GetTimeSeconds();
+	UpdateMovement(GeometryKernels::GetMovementTime(GetWorld()));
+	UpdateTimers(Time);
+	FlushMeshUpdates();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryInstanceRendererComponent::FlushMeshUpdates()
+{
+	for (int32 MeshIndex = 0; MeshIndex < Meshes.Num(); ++MeshIndex)
+	{
+		FMeshInstances& Instances = MeshInstances[MeshIndex];
+		UInstancedStaticMeshComponent* Mesh = Meshes[MeshIndex];
+		if (Instances.RequiredBoundsScale > Mesh->BoundsScale)
+		{
+			Mesh->SetBoundsScale(Instances.RequiredBoundsScale);
+		}
+
+		const bool bTransformsDirty = Instances.DirtyBegin < Instances.DirtyEnd;
+		if (!bTransformsDirty && !Instances.bCustomDataDirty)
+			continue;
+
+		if (bTransformsDirty)
+		{
+			// One call for the changed range, the whole array when the Sin instances are spread over the mesh
+			const int32 NumDirty = Instances.DirtyEnd - Instances.DirtyBegin;
+			if (NumDirty == Instances.Transforms.Num())
+			{
+				Mesh->BatchUpdateInstancesTransforms(0, Instances.Transforms, true, false, true);
+			}
+			else
+			{
+				BatchTransforms.Reset();
+				BatchTransforms.Append(Instances.Transforms.GetData() + Instances.DirtyBegin, NumDirty);
+				Mesh->BatchUpdateInstancesTransforms(Instances.DirtyBegin, BatchTransforms, true, false, true);
+			}
+		}
+
+		// Sends the recorded instance changes at the end of the frame, the scene proxy is kept
+		Mesh->MarkRenderInstancesDirty();
+
+		Instances.DirtyBegin = MAX_int32;
+		Instances.DirtyEnd = 0;
+		Instances.bCustomDataDirty = false;
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+int32 UGeometryInstanceRendererComponent::FindOrAddMesh(TSubclassOf<ABaseGeometryActor> GeometryClass)
+{
+	if (!GeometryClass)
+		return INDEX_NONE;
+
+	if (const int32* Found = MeshIndices.Find(GeometryClass))
+		return *Found;
+
+	// The mesh and the materials are set up on the BaseMesh component of the class defaults
+	const ABaseGeometryActor* Defaults = GeometryClass->GetDefaultObject<ABaseGeometryActor>();
+	const UStaticMeshComponent* BaseMesh = Defaults ? Defaults->BaseMesh : nullptr;
+	UStaticMesh* StaticMesh = BaseMesh ? BaseMesh->GetStaticMesh() : nullptr;
+	if (!StaticMesh)
+	{
+		UE_LOG(LogGeometryInstances, Warning, TEXT("%s has no mesh and can't be instanced"), *GeometryClass->GetName());
+		MeshIndices.Add(GeometryClass, INDEX_NONE);
+		return INDEX_NONE;
+	}
+
+	UInstancedStaticMeshComponent* Mesh = NewObject<UInstancedStaticMeshComponent>(GetOwner());
+	Mesh->SetStaticMesh(StaticMesh);
+	for (int32 i = 0; i < BaseMesh->GetNumMaterials(); ++i)
+	{
+		Mesh->SetMaterial(i, BaseMesh->GetMaterial(i));
+	}
+	Mesh->NumCustomDataFloats = bUseGPUMovement ? NumColorCustomData + 2 : NumColorCustomData;
+	Mesh->SetCollisionProfileName(BaseMesh->GetCollisionProfileName());
+	Mesh->SetMobility(EComponentMobility::Movable);
+	Mesh->RegisterComponent();
+	GetOwner()->AddInstanceComponent(Mesh);
+
+	const int32 MeshIndex = Meshes.Add(Mesh);
+	MeshIndices.Add(GeometryClass, MeshIndex);
+	MeshInstances.AddDefaulted();
+
+	return MeshIndex;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryInstanceRendererComponent::UpdateMovement(float Time)
+{
+	const int32 Num = SinInstances.Num();
+	if (Num == 0)
+		return;
+
+	Offsets.SetNumUninitialized(Num, false);
+	GeometryKernels::ComputeSinOffsets(Amplitudes.GetData(), Frequencies.GetData(), Time, Offsets.GetData(), Num);
+
+	// Only the kept transforms are written here, FlushMeshUpdates hands them to the meshes
+	for (int32 j = 0; j < Num; ++j)
+	{
+		const int32 Index = SinInstances[j];
+		FMeshInstances& Instances = MeshInstances[InstanceMeshes[Index]];
+		const int32 InstanceIndex = InstanceIndices[Index];
+
+		FTransform& Transform = Instances.Transforms[InstanceIndex];
+		Transform = InitialTransforms[j];
+		Transform.AddToTranslation(FVector(0.0f, 0.0f, Offsets[j]));
+		Instances.MarkTransformDirty(InstanceIndex);
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryInstanceRendererComponent::UpdateTimers(float Time)
+{
+	for (int32 i = 0; i < NextFireTimes.Num(); ++i)
+	{
+		if (Time < NextFireTimes[i])
+			continue;
+
+		if (++TimerCounts[i] <= MaxTimerCount)
+		{
+			FGeometryInstanceHandle Handle;
+			Handle.Index = i;
+			SetInstanceColor(Handle, ColorStream.NextColor());
+			NextFireTimes[i] += TimeRates[i];
+		}
+		else
+		{
+			// Same as the hub does with the actors: the finished shape disappears
+			HideInstance(i);
+			NextFireTimes[i] = TNumericLimits<float>::Max();
+		}
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryInstanceRendererComponent::HideInstance(int32 Index)
+{
+	// Removing an instance would reorder the instance indices, a zero scale keeps all handles stable
+	FMeshInstances& Instances = MeshInstances[InstanceMeshes[Index]];
+	const int32 InstanceIndex = InstanceIndices[Index];
+	Instances.Transforms[InstanceIndex].SetScale3D(FVector::ZeroVector);
+	Instances.MarkTransformDirty(InstanceIndex);
+
+	// A hidden instance doesn't need to move anymore
+	RemoveSinInstance(Index);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryInstanceRendererComponent::RemoveSinInstance(int32 Index)
+{
+	const int32 Slot = SinSlots[Index];
+	if (Slot == INDEX_NONE)
+		return;
+
+	SinSlots[Index] = INDEX_NONE;
+	SinInstances.RemoveAtSwap(Slot, 1, false);
+	InitialTransforms.RemoveAtSwap(Slot, 1, false);
+	Amplitudes.RemoveAtSwap(Slot, 1, false);
+	Frequencies.RemoveAtSwap(Slot, 1, false);
+
+	// The last element took the free slot
+	if (Slot < SinInstances.Num())
+	{
+		SinSlots[SinInstances[Slot]] = Slot;
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+FVector UGeometryInstanceRendererComponent::GetInstanceLocationAtTime(FGeometryInstanceHandle Handle, float Time) const
+{
+	if (!InstanceLocations.IsValidIndex(Handle.Index))
+		return FVector::ZeroVector;
+
+	FVector Location = InstanceLocations[Handle.Index];
+	Location.Z += GeometryKernels::EvaluateSinOffset(InstanceAmplitudes[Handle.Index], InstanceFrequencies[Handle.Index], Time);
+	return Location;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+bool UGeometryInstanceRendererComponent::ValidateGPUMovement(FString& OutError) const
+{
+	if (!bUseGPUMovement)
+		return true;
+
+	for (int32 Index = 0; Index < InstanceMeshes.Num(); ++Index)
+	{
+		// Static and hidden instances are not moved by the material
+		if (InstanceAmplitudes[Index] == 0.0f || NextFireTimes[Index] == TNumericLimits<float>::Max())
+			continue;
+
+		const UInstancedStaticMeshComponent* Mesh = Meshes[InstanceMeshes[Index]];
+		const int32 DataOffset = InstanceIndices[Index] * Mesh->NumCustomDataFloats;
+		if (Mesh->NumCustomDataFloats <= FrequencyCustomDataIndex || !Mesh->PerInstanceSMCustomData.IsValidIndex(DataOffset + FrequencyCustomDataIndex))
+		{
+			OutError = FString::Printf(TEXT("instance %d has no movement custom data"), Index);
+			return false;
+		}
+
+		const float Amplitude = Mesh->PerInstanceSMCustomData[DataOffset + AmplitudeCustomDataIndex];
+		const float Frequency = Mesh->PerInstanceSMCustomData[DataOffset + FrequencyCustomDataIndex];
+		if (Amplitude != InstanceAmplitudes[Index] || Frequency != InstanceFrequencies[Index])
+		{
+			OutError = FString::Printf(TEXT("instance %d custom data %f/%f doesn't match %f/%f"), Index, Amplitude, Frequency, InstanceAmplitudes[Index],
+			                           InstanceFrequencies[Index]);
+			return false;
+		}
+
+		FTransform Transform;
+		Mesh->GetInstanceTransform(InstanceIndices[Index], Transform, true);
+		if (!Transform.GetLocation().Equals(InstanceLocations[Index]))
+		{
+			OutError = FString::Printf(TEXT("instance %d was moved on the CPU to %s"), Index, *Transform.GetLocation().ToString());
+			return false;
+		}
+	}
+
+	return true;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+// Validates every GPU-moved geometry actor and instance renderer of the world. Nothing is rendered, so it runs under -nullrhi.
+// Usage: geometry.GPUMovement.Validate
+static FAutoConsoleCommandWithWorldAndArgs GGeometryGPUMovementValidateCommand(
+	TEXT("geometry.GPUMovement.Validate"),
+	TEXT("Checks material parameters, custom data and untouched transforms of all the shapes moved by World Position Offset."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (!World)
+			return;
+
+		int32 NumChecked = 0;
+		int32 NumFailed = 0;
+		FString Error;
+
+		for (TActorIterator<ABaseGeometryActor> It(World); It; ++It)
+		{
+			if (!It->IsGPUMovementActive())
+				continue;
+
+			++NumChecked;
+			if (!It->ValidateGPUMovement(Error))
+			{
+				++NumFailed;
+				UE_LOG(LogGeometryInstances, Error, TEXT("%s: %s"), *It->GetName(), *Error);
+			}
+		}
+
+		for (TActorIterator<AActor> It(World); It; ++It)
+		{
+			for (const UGeometryInstanceRendererComponent* Renderer : TInlineComponentArray<UGeometryInstanceRendererComponent*>(*It))
+			{
+				++NumChecked;
+				if (!Renderer->ValidateGPUMovement(Error))
+				{
+					++NumFailed;
+					UE_LOG(LogGeometryInstances, Error, TEXT("%s: %s"), *Renderer->GetPathName(), *Error);
+				}
+			}
+		}
+
+		UE_LOG(LogGeometryInstances, Display, TEXT("GPU movement validation: %d checked, %d failed"), NumChecked, NumFailed);
+	}));
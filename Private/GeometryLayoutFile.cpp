@@ -0,0 +1,346 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GeometryLayoutFile.h"
+#include "Async/MappedFileHandle.h"
+#include "Dom/JsonObject.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogGeometryLayout, All, All)
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+FGeometryLayoutRecord FGeometryLayoutRecord::Make(const FTransform& Transform, const FGeometryData& Data, uint16 ClassIndex)
+{
+	const FVector Location = Transform.GetLocation();
+	const FQuat Rotation = Transform.GetRotation();
+	const FVector Scale = Transform.GetScale3D();
+
+	FGeometryLayoutRecord Record;
+	Record.Location[0] = Location.X;
+	Record.Location[1] = Location.Y;
+	Record.Location[2] = Location.Z;
+	Record.Rotation[0] = Rotation.X;
+	Record.Rotation[1] = Rotation.Y;
+	Record.Rotation[2] = Rotation.Z;
+	Record.Rotation[3] = Rotation.W;
+	Record.Scale[0] = Scale.X;
+	Record.Scale[1] = Scale.Y;
+	Record.Scale[2] = Scale.Z;
+	Record.Data.Pack(Data);
+	Record.ClassIndex = ClassIndex;
+	Record.Padding = 0;
+	return Record;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+FGeometryLayoutReader::FGeometryLayoutReader() = default;
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+FGeometryLayoutReader::~FGeometryLayoutReader()
+{
+	Close();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+bool FGeometryLayoutReader::Open(const FString& FilePath)
+{
+	Close();
+
+	MappedHandle.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*FilePath));
+	if (MappedHandle)
+	{
+		MappedRegion.Reset(MappedHandle->MapRegion(0, MappedHandle->GetFileSize()));
+	}
+
+	bool bParsed = false;
+	if (MappedRegion)
+	{
+		bParsed = Parse(MappedRegion->GetMappedPtr(), MappedRegion->GetMappedSize(), FilePath);
+	}
+	else if (FFileHelper::LoadFileToArray(FallbackBuffer, *FilePath))
+	{
+		bParsed = Parse(FallbackBuffer.GetData(), FallbackBuffer.Num(), FilePath);
+	}
+	else
+	{
+		UE_LOG(LogGeometryLayout, Error, TEXT("Can't open the geometry layout %s"), *FilePath);
+	}
+
+	if (!bParsed)
+	{
+		Close();
+	}
+	return bParsed;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void FGeometryLayoutReader::Close()
+{
+	Records = nullptr;
+	NumRecords = 0;
+	ClassPaths.Reset();
+
+	// The region must go before the file handle it was mapped from
+	MappedRegion.Reset();
+	MappedHandle.Reset();
+	FallbackBuffer.Empty();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+bool FGeometryLayoutReader::Parse(const uint8* Data, int64 Size, const FString& FilePath)
+{
+	if (Size < static_cast<int64>(sizeof(FGeometryLayoutHeader)))
+	{
+		UE_LOG(LogGeometryLayout, Error, TEXT("%s is too small for a geometry layout"), *FilePath);
+		return false;
+	}
+
+	FGeometryLayoutHeader Header;
+	FMemory::Memcpy(&Header, Data, sizeof(Header));
+
+	if (Header.Magic != GeometryLayout::Magic)
+	{
+		UE_LOG(LogGeometryLayout, Error, TEXT("%s is not a geometry layout"), *FilePath);
+		return false;
+	}
+	if (Header.Version != GeometryLayout::Version || Header.RecordSize != sizeof(FGeometryLayoutRecord))
+	{
+		UE_LOG(LogGeometryLayout, Error, TEXT("%s has layout version %u, expected %u. Convert the source again."), *FilePath, Header.Version,
+		       GeometryLayout::Version);
+		return false;
+	}
+
+	const int64 RecordsEnd = static_cast<int64>(Header.RecordsOffset) + static_cast<int64>(Header.NumRecords) * sizeof(FGeometryLayoutRecord);
+	if (RecordsEnd > Size || Header.RecordsOffset % GeometryLayout::RecordAlignment != 0 || Header.NumRecords > MAX_int32)
+	{
+		UE_LOG(LogGeometryLayout, Error, TEXT("%s is truncated or corrupt"), *FilePath);
+		return false;
+	}
+
+	// Class table, the only part which is converted
+	int64 Offset = sizeof(FGeometryLayoutHeader);
+	ClassPaths.Reserve(Header.NumClasses);
+	for (uint32 ClassIndex = 0; ClassIndex < Header.NumClasses; ++ClassIndex)
+	{
+		uint32 Length = 0;
+		if (Offset + static_cast<int64>(sizeof(Length)) > Header.RecordsOffset)
+		{
+			UE_LOG(LogGeometryLayout, Error, TEXT("%s has a corrupt class table"), *FilePath);
+			return false;
+		}
+		FMemory::Memcpy(&Length, Data + Offset, sizeof(Length));
+		Offset += sizeof(Length);
+
+		if (Offset + Length > Header.RecordsOffset)
+		{
+			UE_LOG(LogGeometryLayout, Error, TEXT("%s has a corrupt class table"), *FilePath);
+			return false;
+		}
+		const FUTF8ToTCHAR Path(reinterpret_cast<const UTF8CHAR*>(Data + Offset), Length);
+		ClassPaths.Emplace(FString(Path.Length(), Path.Get()));
+		Offset += Length;
+	}
+
+	Records = reinterpret_cast<const FGeometryLayoutRecord*>(Data + Header.RecordsOffset);
+	NumRecords = static_cast<int32>(Header.NumRecords);
+	return true;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void FGeometryLayoutWriter::Add(const FSoftObjectPath& ClassPath, const FTransform& Transform, const FGeometryData& Data)
+{
+	uint16* ClassIndex = ClassIndices.Find(ClassPath);
+	if (!ClassIndex)
+	{
+		check(ClassPaths.Num() <= MAX_uint16);
+		ClassIndex = &ClassIndices.Add(ClassPath, static_cast<uint16>(ClassPaths.Add(ClassPath)));
+	}
+
+	Records.Add(FGeometryLayoutRecord::Make(Transform, Data, *ClassIndex));
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+bool FGeometryLayoutWriter::Save(const FString& FilePath) const
+{
+	TArray<uint8> Bytes;
+	Bytes.AddZeroed(sizeof(FGeometryLayoutHeader));
+
+	for (const FSoftObjectPath& ClassPath : ClassPaths)
+	{
+		const FTCHARToUTF8 Path(*ClassPath.ToString());
+		const uint32 Length = Path.Length();
+		Bytes.Append(reinterpret_cast<const uint8*>(&Length), sizeof(Length));
+		Bytes.Append(reinterpret_cast<const uint8*>(Path.Get()), Length);
+	}
+	Bytes.AddZeroed(Align(Bytes.Num(), GeometryLayout::RecordAlignment) - Bytes.Num());
+
+	FGeometryLayoutHeader Header;
+	Header.RecordSize = sizeof(FGeometryLayoutRecord);
+	Header.NumClasses = ClassPaths.Num();
+	Header.NumRecords = Records.Num();
+	Header.RecordsOffset = Bytes.Num();
+	FMemory::Memcpy(Bytes.GetData(), &Header, sizeof(Header));
+
+	Bytes.Append(reinterpret_cast<const uint8*>(Records.GetData()), Records.Num() * sizeof(FGeometryLayoutRecord));
+
+	return FFileHelper::SaveArrayToFile(Bytes, *FilePath);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+bool FGeometryLayoutWriter::Convert(const FString& SourcePath, const FString& TargetPath, FString& OutError)
+{
+	FString Source;
+	if (!FFileHelper::LoadFileToString(Source, *SourcePath))
+	{
+		OutError = FString::Printf(TEXT("Can't read %s"), *SourcePath);
+		return false;
+	}
+
+	// Every row as field name -> value, CSV and JSON end up in the same form
+	TArray<TMap<FString, FString>> Rows;
+
+	if (FPaths::GetExtension(SourcePath).Equals(TEXT("json"), ESearchCase::IgnoreCase))
+	{
+		TArray<TSharedPtr<FJsonValue>> Values;
+		if (!FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(Source), Values))
+		{
+			OutError = FString::Printf(TEXT("%s is not a JSON array"), *SourcePath);
+			return false;
+		}
+
+		for (const TSharedPtr<FJsonValue>& Value : Values)
+		{
+			const TSharedPtr<FJsonObject>* Object = nullptr;
+			if (!Value.IsValid() || !Value->TryGetObject(Object))
+				continue;
+
+			TMap<FString, FString>& Row = Rows.AddDefaulted_GetRef();
+			for (const TPair<FString, TSharedPtr<FJsonValue>>& Field : (*Object)->Values)
+			{
+				FString FieldValue;
+				if (Field.Value.IsValid() && Field.Value->TryGetString(FieldValue))
+				{
+					Row.Add(Field.Key, FieldValue);
+				}
+			}
+		}
+	}
+	else
+	{
+		TArray<FString> Lines;
+		Source.ParseIntoArrayLines(Lines);
+		if (Lines.Num() == 0)
+		{
+			OutError = FString::Printf(TEXT("%s is empty"), *SourcePath);
+			return false;
+		}
+
+		TArray<FString> Columns;
+		Lines[0].ParseIntoArray(Columns, TEXT(","), false);
+		for (FString& Column : Columns)
+		{
+			Column.TrimStartAndEndInline();
+		}
+
+		TArray<FString> Cells;
+		for (int32 LineIndex = 1; LineIndex < Lines.Num(); ++LineIndex)
+		{
+			Lines[LineIndex].ParseIntoArray(Cells, TEXT(","), false);
+			TMap<FString, FString>& Row = Rows.AddDefaulted_GetRef();
+			for (int32 Column = 0; Column < FMath::Min(Columns.Num(), Cells.Num()); ++Column)
+			{
+				Row.Add(Columns[Column], Cells[Column].TrimStartAndEnd());
+			}
+		}
+	}
+
+	const UEnum* MoveTypeEnum = StaticEnum<EMovementType>();
+	FGeometryLayoutWriter Writer;
+
+	for (int32 RowIndex = 0; RowIndex < Rows.Num(); ++RowIndex)
+	{
+		const TMap<FString, FString>& Row = Rows[RowIndex];
+		const auto GetFloat = [&Row](const TCHAR* Field, float Default)
+		{
+			const FString* Value = Row.Find(Field);
+			return Value && !Value->IsEmpty() ? FCString::Atof(**Value) : Default;
+		};
+
+		const FString* ClassPath = Row.Find(TEXT("Class"));
+		if (!ClassPath || ClassPath->IsEmpty())
+		{
+			OutError = FString::Printf(TEXT("Row %d has no Class"), RowIndex + 1);
+			return false;
+		}
+
+		const FTransform Transform(FRotator(GetFloat(TEXT("Pitch"), 0.0f), GetFloat(TEXT("Yaw"), 0.0f), GetFloat(TEXT("Roll"), 0.0f)),
+		                           FVector(GetFloat(TEXT("X"), 0.0f), GetFloat(TEXT("Y"), 0.0f), GetFloat(TEXT("Z"), 0.0f)),
+		                           FVector(GetFloat(TEXT("ScaleX"), 1.0f), GetFloat(TEXT("ScaleY"), 1.0f), GetFloat(TEXT("ScaleZ"), 1.0f)));
+
+		FGeometryData Data;
+		Data.Amplitude = GetFloat(TEXT("Amplitude"), Data.Amplitude);
+		Data.Frequency = GetFloat(TEXT("Frequency"), Data.Frequency);
+		Data.TimeRate = GetFloat(TEXT("TimeRate"), Data.TimeRate);
+		Data.Color = FLinearColor(GetFloat(TEXT("R"), Data.Color.R), GetFloat(TEXT("G"), Data.Color.G), GetFloat(TEXT("B"), Data.Color.B),
+		                          GetFloat(TEXT("A"), Data.Color.A));
+
+		const FString* MoveType = Row.Find(TEXT("MoveType"));
+		if (MoveType && !MoveType->IsEmpty())
+		{
+			// Either the enum name or its value
+			int64 Value = MoveTypeEnum->GetValueByNameString(*MoveType);
+			if (Value == INDEX_NONE && MoveType->IsNumeric())
+			{
+				Value = FCString::Atoi64(**MoveType);
+			}
+			// The packed form would keep the low bits of any other value and turn it into a different move type
+			if (Value < 0 || Value > static_cast<int64>(EMovementType::Custom3))
+			{
+				OutError = FString::Printf(TEXT("Row %d has the unknown MoveType %s"), RowIndex + 1, **MoveType);
+				return false;
+			}
+			Data.MoveType = static_cast<EMovementType>(Value);
+		}
+
+		Writer.Add(FSoftObjectPath(*ClassPath), Transform, Data);
+	}
+
+	if (!Writer.Save(TargetPath))
+	{
+		OutError = FString::Printf(TEXT("Can't write %s"), *TargetPath);
+		return false;
+	}
+	return true;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+// Usage: geometry.Layout.Convert <Source.csv|Source.json> <Target.bin>, relative paths are relative to the project directory
+static FAutoConsoleCommand GGeometryLayoutConvertCommand(
+	TEXT("geometry.Layout.Convert"),
+	TEXT("Converts a CSV or JSON payload export to a binary geometry layout."),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		if (Args.Num() < 2)
+		{
+			UE_LOG(LogGeometryLayout, Warning, TEXT("Usage: geometry.Layout.Convert <Source.csv|Source.json> <Target.bin>"));
+			return;
+		}
+
+		const FString SourcePath = FPaths::ConvertRelativePathToFull(FPaths::ProjectDir(), Args[0]);
+		const FString TargetPath = FPaths::ConvertRelativePathToFull(FPaths::ProjectDir(), Args[1]);
+
+		FString Error;
+		if (FGeometryLayoutWriter::Convert(SourcePath, TargetPath, Error))
+		{
+			UE_LOG(LogGeometryLayout, Display, TEXT("Geometry layout written to %s"), *TargetPath);
+		}
+		else
+		{
+			UE_LOG(LogGeometryLayout, Error, TEXT("Conversion failed: %s"), *Error);
+		}
+	}));
@@ -0,0 +1,152 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GeometryMassProcessors.h"
+#include "GeometryMassFragments.h"
+#include "GeometryMovementKernels.h"
+#include "GeometryStats.h"
+#include "MassCommonFragments.h"
+#include "MassExecutionContext.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "Engine/World.h"
+
+DECLARE_CYCLE_STAT(TEXT("Mass Sin Movement"), STAT_GeometryMassSinMovement, STATGROUP_GeometryActors);
+DECLARE_CYCLE_STAT(TEXT("Mass Color Cycle"), STAT_GeometryMassColorCycle, STATGROUP_GeometryActors);
+
+// Same as ABaseGeometryActor::MaxTimerCount
+static constexpr int32 GeometryMassMaxTimerCount = 5;
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+UGeometrySinMovementProcessor::UGeometrySinMovementProcessor()
+	: EntityQuery(*this)
+{
+	bAutoRegisterWithProcessingPhases = true;
+	ExecutionFlags = static_cast<int32>(EProcessorExecutionFlags::All);
+	// The instances live in a component, which may only be touched on the game thread
+	bRequiresGameThreadExecution = true;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometrySinMovementProcessor::ConfigureQueries()
+{
+	EntityQuery.AddRequirement<FGeometryMovementFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FGeometryInstanceFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddTagRequirement<FGeometrySinTag>(EMassFragmentPresence::All);
+	EntityQuery.AddConstSharedRequirement<FGeometryClassSharedFragment>();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometrySinMovementProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context)
+{
+	SCOPE_CYCLE_COUNTER(STAT_GeometryMassSinMovement);
+	TRACE_CPUPROFILER_EVENT_SCOPE(UGeometrySinMovementProcessor::Execute);
+
+	const float Time = GeometryKernels::GetMovementTime(Context.GetWorld());
+
+	EntityQuery.ForEachEntityChunk(EntityManager, Context, [this, Time](FMassExecutionContext& ChunkContext)
+	{
+		const int32 Num = ChunkContext.GetNumEntities();
+		const TConstArrayView<FGeometryMovementFragment> Movements = ChunkContext.GetFragmentView<FGeometryMovementFragment>();
+		const TConstArrayView<FGeometryInstanceFragment> Instances = ChunkContext.GetFragmentView<FGeometryInstanceFragment>();
+		const TArrayView<FTransformFragment> Transforms = ChunkContext.GetMutableFragmentView<FTransformFragment>();
+		UGeometryInstanceRendererComponent* Renderer = ChunkContext.GetConstSharedFragment<FGeometryClassSharedFragment>().Renderer.Get();
+
+		// Pass 1: the chunk's parameters side by side for the vectorized kernel
+		Amplitudes.SetNumUninitialized(Num, false);
+		Frequencies.SetNumUninitialized(Num, false);
+		Offsets.SetNumUninitialized(Num, false);
+		for (int32 i = 0; i < Num; ++i)
+		{
+			Amplitudes[i] = Movements[i].Amplitude;
+			Frequencies[i] = Movements[i].Frequency;
+		}
+		GeometryKernels::ComputeSinOffsets(Amplitudes.GetData(), Frequencies.GetData(), Time, Offsets.GetData(), Num);
+
+		// Pass 2: write the transforms and gather them for the renderer
+		InstanceHandles.Reset(Num);
+		InstanceTransforms.Reset(Num);
+		for (int32 i = 0; i < Num; ++i)
+		{
+			FTransform& Transform = Transforms[i].GetMutableTransform();
+			FVector Location = Movements[i].InitialLocation;
+			Location.Z += Offsets[i];
+			Transform.SetLocation(Location);
+
+			InstanceHandles.Add(Instances[i].Instance);
+			InstanceTransforms.Add(Transform);
+		}
+
+		// One call for the chunk, all its entities share the renderer and the mesh
+		if (Renderer)
+		{
+			Renderer->SetInstanceTransforms(InstanceHandles, InstanceTransforms);
+		}
+	});
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+UGeometryColorCycleProcessor::UGeometryColorCycleProcessor()
+	: EntityQuery(*this)
+{
+	bAutoRegisterWithProcessingPhases = true;
+	ExecutionFlags = static_cast<int32>(EProcessorExecutionFlags::All);
+	bRequiresGameThreadExecution = true;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryColorCycleProcessor::ConfigureQueries()
+{
+	EntityQuery.AddRequirement<FGeometryTimerFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddRequirement<FGeometryColorFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddRequirement<FGeometryInstanceFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddConstSharedRequirement<FGeometryClassSharedFragment>();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryColorCycleProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context)
+{
+	SCOPE_CYCLE_COUNTER(STAT_GeometryMassColorCycle);
+	TRACE_CPUPROFILER_EVENT_SCOPE(UGeometryColorCycleProcessor::Execute);
+
+	const float Time = Context.GetWorld()->GetTimeSeconds();
+
+	EntityQuery.ForEachEntityChunk(EntityManager, Context, [this, Time](FMassExecutionContext& ChunkContext)
+	{
+		const int32 Num = ChunkContext.GetNumEntities();
+		const TArrayView<FGeometryTimerFragment> Timers = ChunkContext.GetMutableFragmentView<FGeometryTimerFragment>();
+		const TArrayView<FGeometryColorFragment> Colors = ChunkContext.GetMutableFragmentView<FGeometryColorFragment>();
+		const TConstArrayView<FGeometryInstanceFragment> Instances = ChunkContext.GetFragmentView<FGeometryInstanceFragment>();
+		UGeometryInstanceRendererComponent* Renderer = ChunkContext.GetConstSharedFragment<FGeometryClassSharedFragment>().Renderer.Get();
+
+		ColorHandles.Reset();
+		NewColors.Reset();
+		RemovedHandles.Reset();
+
+		for (int32 i = 0; i < Num; ++i)
+		{
+			FGeometryTimerFragment& Timer = Timers[i];
+			if (Time < Timer.NextFireTime)
+				continue;
+
+			if (++Timer.TimerCount <= GeometryMassMaxTimerCount)
+			{
+				Colors[i].Color = Timer.ColorStream.NextColor();
+				Timer.NextFireTime += Timer.TimeRate;
+				ColorHandles.Add(Instances[i].Instance);
+				NewColors.Add(Colors[i].Color);
+				continue;
+			}
+
+			// Same as the hub does with the actors: the finished shape disappears. The entity is destroyed after the chunk loop.
+			RemovedHandles.Add(Instances[i].Instance);
+			ChunkContext.Defer().DestroyEntity(ChunkContext.GetEntity(i));
+		}
+
+		if (Renderer)
+		{
+			Renderer->SetInstanceColors(ColorHandles, NewColors);
+			Renderer->RemoveInstances(RemovedHandles);
+		}
+	});
+}
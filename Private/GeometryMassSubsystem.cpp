@@ -0,0 +1,155 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GeometryMassSubsystem.h"
+#include "GeometryInstanceRendererComponent.h"
+#include "GeometryMassFragments.h"
+#include "MassCommonFragments.h"
+#include "MassEntitySubsystem.h"
+#include "MassExecutionContext.h"
+#include "Engine/World.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogGeometryMass, All, All)
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryMassSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+	Collection.InitializeDependency<UMassEntitySubsystem>();
+
+	LocationQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadOnly);
+	LocationQuery.AddRequirement<FGeometryMovementFragment>(EMassFragmentAccess::ReadOnly);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+FMassEntityHandle UGeometryMassSubsystem::SpawnEntity(UGeometryInstanceRendererComponent* Renderer, TSubclassOf<ABaseGeometryActor> GeometryClass,
+                                                      const FTransform& Transform, const FGeometryData& Data)
+{
+	UMassEntitySubsystem* EntitySubsystem = GetWorld()->GetSubsystem<UMassEntitySubsystem>();
+	if (!Renderer || !EntitySubsystem)
+		return FMassEntityHandle();
+
+	// The renderer only draws the instance, the processors move it and cycle its color
+	const FGeometryInstanceHandle Instance = Renderer->AddInstance(GeometryClass, Transform, Data, false);
+	if (!Instance.IsValid())
+		return FMassEntityHandle();
+
+	FMassEntityManager& EntityManager = EntitySubsystem->GetMutableEntityManager();
+
+	FGeometryClassSharedFragment ClassFragment;
+	ClassFragment.Renderer = Renderer;
+	ClassFragment.GeometryClass = GeometryClass;
+
+	FMassArchetypeSharedFragmentValues SharedValues;
+	SharedValues.AddConstSharedFragment(EntityManager.GetOrCreateConstSharedFragment(ClassFragment));
+	SharedValues.Sort();
+
+	const bool bSin = Data.MoveType == EMovementType::Sin;
+	FMassArchetypeHandle& Archetype = bSin ? SinArchetype : StaticArchetype;
+	if (!Archetype.IsValid())
+	{
+		TArray<const UScriptStruct*> Composition = {
+			FTransformFragment::StaticStruct(), FGeometryMovementFragment::StaticStruct(), FGeometryColorFragment::StaticStruct(),
+			FGeometryTimerFragment::StaticStruct(), FGeometryInstanceFragment::StaticStruct()
+		};
+		if (bSin)
+		{
+			Composition.Add(FGeometrySinTag::StaticStruct());
+		}
+		Archetype = EntityManager.CreateArchetype(Composition, SharedValues, bSin ? FName("GeometrySin") : FName("GeometryStatic"));
+	}
+
+	const FMassEntityHandle Entity = EntityManager.CreateEntity(Archetype, SharedValues);
+
+	EntityManager.GetFragmentDataChecked<FTransformFragment>(Entity).SetTransform(Transform);
+
+	FGeometryMovementFragment& Movement = EntityManager.GetFragmentDataChecked<FGeometryMovementFragment>(Entity);
+	Movement.InitialLocation = Transform.GetLocation();
+	Movement.Amplitude = Data.Amplitude;
+	Movement.Frequency = Data.Frequency;
+	Movement.MoveType = Data.MoveType;
+
+	EntityManager.GetFragmentDataChecked<FGeometryColorFragment>(Entity).Color = Data.Color;
+
+	FGeometryTimerFragment& Timer = EntityManager.GetFragmentDataChecked<FGeometryTimerFragment>(Entity);
+	Timer.TimeRate = Data.TimeRate;
+	Timer.NextFireTime = GetWorld()->GetTimeSeconds() + Data.TimeRate;
+	Timer.ColorStream = GeometryRandom::MakeStream(NumSpawnedEntities++);
+
+	EntityManager.GetFragmentDataChecked<FGeometryInstanceFragment>(Entity).Instance = Instance;
+
+	return Entity;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+ABaseGeometryActor* UGeometryMassSubsystem::PromoteToActor(FMassEntityHandle Entity)
+{
+	UMassEntitySubsystem* EntitySubsystem = GetWorld()->GetSubsystem<UMassEntitySubsystem>();
+	if (!EntitySubsystem)
+		return nullptr;
+
+	FMassEntityManager& EntityManager = EntitySubsystem->GetMutableEntityManager();
+	if (!EntityManager.IsEntityValid(Entity))
+		return nullptr;
+
+	if (EntityManager.IsProcessing())
+	{
+		UE_LOG(LogGeometryMass, Warning, TEXT("Geometry entities can't be promoted while Mass processors run"));
+		return nullptr;
+	}
+
+	const FGeometryClassSharedFragment* ClassFragment = EntityManager.GetConstSharedFragmentDataPtr<FGeometryClassSharedFragment>(Entity);
+	if (!ClassFragment || !ClassFragment->GeometryClass)
+		return nullptr;
+
+	const FGeometryMovementFragment& Movement = EntityManager.GetFragmentDataChecked<FGeometryMovementFragment>(Entity);
+	FGeometryData Data;
+	Data.Amplitude = Movement.Amplitude;
+	Data.Frequency = Movement.Frequency;
+	Data.MoveType = Movement.MoveType;
+	Data.Color = EntityManager.GetFragmentDataChecked<FGeometryColorFragment>(Entity).Color;
+	Data.TimeRate = EntityManager.GetFragmentDataChecked<FGeometryTimerFragment>(Entity).TimeRate;
+
+	// Spawned at the initial location: the actor evaluates the same Sin of the world time, so it continues the motion seamlessly
+	FTransform Transform = EntityManager.GetFragmentDataChecked<FTransformFragment>(Entity).GetTransform();
+	Transform.SetLocation(Movement.InitialLocation);
+
+	ABaseGeometryActor* Geometry = GetWorld()->SpawnActorDeferred<ABaseGeometryActor>(ClassFragment->GeometryClass, Transform);
+	if (!Geometry)
+		return nullptr;
+
+	Geometry->SetGeometryData(Data);
+	Geometry->FinishSpawning(Transform);
+
+	if (UGeometryInstanceRendererComponent* Renderer = ClassFragment->Renderer.Get())
+	{
+		Renderer->RemoveInstance(EntityManager.GetFragmentDataChecked<FGeometryInstanceFragment>(Entity).Instance);
+	}
+	EntityManager.DestroyEntity(Entity);
+
+	return Geometry;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryMassSubsystem::CollectEntitiesInSphere(const FVector& Center, float Radius, TArray<FMassEntityHandle>& OutEntities)
+{
+	UMassEntitySubsystem* EntitySubsystem = GetWorld()->GetSubsystem<UMassEntitySubsystem>();
+	if (!EntitySubsystem)
+		return;
+
+	FMassEntityManager& EntityManager = EntitySubsystem->GetMutableEntityManager();
+	FMassExecutionContext Context(EntityManager);
+	const float RadiusSquared = FMath::Square(Radius);
+
+	LocationQuery.ForEachEntityChunk(EntityManager, Context, [&Center, RadiusSquared, &OutEntities](FMassExecutionContext& ChunkContext)
+	{
+		const TConstArrayView<FTransformFragment> Transforms = ChunkContext.GetFragmentView<FTransformFragment>();
+		for (int32 i = 0; i < ChunkContext.GetNumEntities(); ++i)
+		{
+			if (FVector::DistSquared(Transforms[i].GetTransform().GetLocation(), Center) <= RadiusSquared)
+			{
+				OutEntities.Add(ChunkContext.GetEntity(i));
+			}
+		}
+	});
+}
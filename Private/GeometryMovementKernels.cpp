@@ -0,0 +1,122 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GeometryMovementKernels.h"
+#include "Engine/World.h"
+#include "GameFramework/GameStateBase.h"
+#include "HAL/IConsoleManager.h"
+
+static TAutoConsoleVariable<bool> CVarGeometryUseSIMD(
+	TEXT("geometry.Movement.UseSIMD"),
+	true,
+	TEXT("If true, the geometry Sin movement is evaluated with the vectorized kernel, otherwise with FMath::Sin per actor."));
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+// Phase minus the nearest multiple of 2 PI. VectorSin does this with a single multiply-subtract, which loses about |Phase| * 1e-7
+// radians; 2 PI split into an exact high part and a low part keeps the reduction within about 2e-5 up to SinReductionRange.
+static FORCEINLINE VectorRegister4Float ReduceSinPhase(const VectorRegister4Float& Phase)
+{
+	constexpr float TwoPiHigh = 6.28125f;
+	constexpr float TwoPiLow = static_cast<float>(UE_DOUBLE_TWO_PI - 6.28125);
+
+	const VectorRegister4Float Turns = VectorFloor(VectorMultiplyAdd(Phase, VectorSetFloat1(1.0f / UE_TWO_PI), VectorSetFloat1(0.5f)));
+	const VectorRegister4Float Reduced = VectorNegateMultiplyAdd(Turns, VectorSetFloat1(TwoPiHigh), Phase);
+	return VectorNegateMultiplyAdd(Turns, VectorSetFloat1(TwoPiLow), Reduced);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void GeometryKernels::ComputeSinOffsets(const float* RESTRICT Amplitudes, const float* RESTRICT Frequencies, float Time, float* RESTRICT OutOffsets,
+                                        int32 Num)
+{
+	if (!PLATFORM_ENABLE_VECTORINTRINSICS || !CVarGeometryUseSIMD.GetValueOnAnyThread())
+	{
+		ComputeSinOffsetsScalar(Amplitudes, Frequencies, Time, OutOffsets, Num);
+		return;
+	}
+
+	const VectorRegister4Float TimeVec = VectorSetFloat1(Time);
+	const VectorRegister4Float ReductionRange = VectorSetFloat1(SinReductionRange);
+	int32 i = 0;
+
+	// 8 lanes per iteration: two independent 4-wide registers hide the latency of the polynomial
+	for (; i + 8 <= Num; i += 8)
+	{
+		const VectorRegister4Float Phase0 = VectorMultiply(VectorLoad(Frequencies + i), TimeVec);
+		const VectorRegister4Float Phase1 = VectorMultiply(VectorLoad(Frequencies + i + 4), TimeVec);
+		if (VectorAnyGreaterThan(VectorMax(VectorAbs(Phase0), VectorAbs(Phase1)), ReductionRange))
+		{
+			ComputeSinOffsetsScalar(Amplitudes + i, Frequencies + i, Time, OutOffsets + i, 8);
+			continue;
+		}
+		VectorStore(VectorMultiply(VectorLoad(Amplitudes + i), VectorSin(ReduceSinPhase(Phase0))), OutOffsets + i);
+		VectorStore(VectorMultiply(VectorLoad(Amplitudes + i + 4), VectorSin(ReduceSinPhase(Phase1))), OutOffsets + i + 4);
+	}
+
+	for (; i + 4 <= Num; i += 4)
+	{
+		const VectorRegister4Float Phase = VectorMultiply(VectorLoad(Frequencies + i), TimeVec);
+		if (VectorAnyGreaterThan(VectorAbs(Phase), ReductionRange))
+		{
+			ComputeSinOffsetsScalar(Amplitudes + i, Frequencies + i, Time, OutOffsets + i, 4);
+			continue;
+		}
+		VectorStore(VectorMultiply(VectorLoad(Amplitudes + i), VectorSin(ReduceSinPhase(Phase))), OutOffsets + i);
+	}
+
+	// Tail which doesn't fill a whole register
+	ComputeSinOffsetsScalar(Amplitudes + i, Frequencies + i, Time, OutOffsets + i, Num - i);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void GeometryKernels::ComputeSinOffsetsScalar(const float* RESTRICT Amplitudes, const float* RESTRICT Frequencies, float Time, float* RESTRICT OutOffsets,
+                                              int32 Num)
+{
+	for (int32 i = 0; i < Num; ++i)
+	{
+		OutOffsets[i] = Amplitudes[i] * FMath::Sin(Frequencies[i] * Time);
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+bool GeometryKernels::ValidateSinKernel(float& OutMaxError)
+{
+	// Unit amplitudes and two sweeps of frequencies at Time = 1, so Frequency is the sin argument itself:
+	// the first one checks the polynomial densely, the second one the range reduction and the scalar fallback
+	constexpr int32 NumSweepSamples = 4099;
+	constexpr float DenseRange = 1000.0f;
+	constexpr int32 NumSamples = 2 * NumSweepSamples;
+	TArray<float> Amplitudes;
+	TArray<float> Frequencies;
+	TArray<float> Offsets;
+	Amplitudes.Init(1.0f, NumSamples);
+	Frequencies.SetNumUninitialized(NumSamples);
+	Offsets.SetNumUninitialized(NumSamples);
+
+	for (int32 i = 0; i < NumSweepSamples; ++i)
+	{
+		const float Alpha = static_cast<float>(i) / (NumSweepSamples - 1);
+		Frequencies[i] = FMath::Lerp(-DenseRange, DenseRange, Alpha);
+		Frequencies[NumSweepSamples + i] = FMath::Lerp(-SinValidationRange, SinValidationRange, Alpha);
+	}
+
+	ComputeSinOffsets(Amplitudes.GetData(), Frequencies.GetData(), 1.0f, Offsets.GetData(), NumSamples);
+
+	OutMaxError = 0.0f;
+	for (int32 i = 0; i < NumSamples; ++i)
+	{
+		OutMaxError = FMath::Max(OutMaxError, FMath::Abs(Offsets[i] - FMath::Sin(Frequencies[i])));
+	}
+
+	return OutMaxError <= SinAccuracyBound;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+float GeometryKernels::GetMovementTime(const UWorld* World)
+{
+	if (!World)
+		return 0.0f;
+
+	// The game state replicates the offset between the client and the server clock
+	const AGameStateBase* GameState = World->GetGameState();
+	return GameState ? static_cast<float>(GameState->GetServerWorldTimeSeconds()) : World->GetTimeSeconds();
+}
@@ -0,0 +1,63 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GeometryMovementModels.h"
+#include "GeometryPackedData.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogGeometryMovementModels, All, All)
+
+static_assert(GeometryMovement::MaxMovementTypes <= (1 << FPackedGeometryData::MoveTypeBits), "Every movement type must fit into the packed data");
+static_assert(static_cast<int32>(EMovementType::Custom3) < GeometryMovement::MaxMovementTypes, "Raise GeometryMovement::MaxMovementTypes");
+
+namespace
+{
+	struct FGeometryMovementRegistry
+	{
+		FGeometryMovementRegistry()
+		{
+			// Static has no model, it doesn't move
+			Models[static_cast<int32>(EMovementType::Sin)] = GeometryMovement::MakeMovementModel<GeometryMovement::FSinModel>(TEXT("Sin"));
+			Models[static_cast<int32>(EMovementType::Orbit)] = GeometryMovement::MakeMovementModel<GeometryMovement::FOrbitModel>(TEXT("Orbit"));
+			Models[static_cast<int32>(EMovementType::Bounce)] = GeometryMovement::MakeMovementModel<GeometryMovement::FBounceModel>(TEXT("Bounce"));
+			Models[static_cast<int32>(EMovementType::Lissajous)] =
+				GeometryMovement::MakeMovementModel<GeometryMovement::FLissajousModel>(TEXT("Lissajous"));
+		}
+
+		FGeometryMovementModel Models[GeometryMovement::MaxMovementTypes];
+	};
+
+	// Created on first use, so models can be registered from static initializers of other modules
+	FGeometryMovementRegistry& GetRegistry()
+	{
+		static FGeometryMovementRegistry Registry;
+		return Registry;
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void GeometryMovement::RegisterModel(EMovementType Type, const FGeometryMovementModel& Model)
+{
+	check(IsInGameThread());
+
+	const int32 Index = static_cast<int32>(Type);
+	// The groups of the type call the new functions at their next update, they must not be null
+	if (Index >= MaxMovementTypes || Type == EMovementType::Static || Type == EMovementType::Sin || !Model.IsValid())
+	{
+		// Sin has its own path with the vectorized kernel, significance and fixed steps
+		UE_LOG(LogGeometryMovementModels, Warning, TEXT("Movement type %d can't be bound to model %s"), Index, Model.Name ? Model.Name : TEXT("?"));
+		return;
+	}
+
+	GetRegistry().Models[Index] = Model;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+const FGeometryMovementModel* GeometryMovement::FindModel(EMovementType Type)
+{
+	const int32 Index = static_cast<int32>(Type);
+	if (Index >= MaxMovementTypes)
+		return nullptr;
+
+	const FGeometryMovementModel& Model = GetRegistry().Models[Index];
+	return Model.IsValid() ? &Model : nullptr;
+}
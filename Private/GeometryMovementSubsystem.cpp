@@ -0,0 +1,841 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GeometryMovementSubsystem.h"
+#include "BaseGeometryActor.h"
+#include "GeometryMovementKernels.h"
+#include "GeometryMovementModels.h"
+#include "GeometryStats.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "Engine/World.h"
+#include "Camera/PlayerCameraManager.h"
+#include "GameFramework/PlayerController.h"
+#include "Async/ParallelFor.h"
+#include "HAL/IConsoleManager.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogGeometryMovement, All, All)
+
+DECLARE_CYCLE_STAT(TEXT("Batched Movement"), STAT_GeometryBatchedMovement, STATGROUP_GeometryActors);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Batched Movement Actors"), STAT_GeometryBatchedMovementActors, STATGROUP_GeometryActors);
+DECLARE_CYCLE_STAT(TEXT("Significance"), STAT_GeometrySignificance, STATGROUP_GeometryActors);
+DECLARE_CYCLE_STAT(TEXT("Movement Model Groups"), STAT_GeometryGroupMovement, STATGROUP_GeometryActors);
+DECLARE_CYCLE_STAT(TEXT("Fixed Step Simulate"), STAT_GeometryFixedStepSimulate, STATGROUP_GeometryActors);
+DECLARE_CYCLE_STAT(TEXT("Fixed Step Interpolate"), STAT_GeometryFixedStepInterpolate, STATGROUP_GeometryActors);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Fixed Steps"), STAT_GeometryFixedSteps, STATGROUP_GeometryActors);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Significance Bucket 0"), STAT_GeometrySignificanceBucket0, STATGROUP_GeometryActors);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Significance Bucket 1"), STAT_GeometrySignificanceBucket1, STATGROUP_GeometryActors);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Significance Bucket 2"), STAT_GeometrySignificanceBucket2, STATGROUP_GeometryActors);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Significance Bucket 3"), STAT_GeometrySignificanceBucket3, STATGROUP_GeometryActors);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Significance Frozen"), STAT_GeometrySignificanceFrozen, STATGROUP_GeometryActors);
+
+static TAutoConsoleVariable<bool> CVarGeometryParallelMovement(
+	TEXT("geometry.Movement.Parallel"),
+	false,
+	TEXT("If true, the new locations are computed on worker threads with ParallelFor and committed in bulk on the game thread."));
+
+static TAutoConsoleVariable<int32> CVarGeometryParallelChunkSize(
+	TEXT("geometry.Movement.ParallelChunkSize"),
+	1024,
+	TEXT("Number of actors processed by one ParallelFor task in the parallel movement update."));
+
+static TAutoConsoleVariable<bool> CVarGeometrySignificance(
+	TEXT("geometry.Significance.Enabled"),
+	true,
+	TEXT("If true, geometry actors far from the player camera are moved and ticked less often."));
+
+static TAutoConsoleVariable<float> CVarGeometryFixedStepRate(
+	TEXT("geometry.Movement.FixedStepRate"),
+	0.0f,
+	TEXT("Rate in Hz at which the batched Sin movement is simulated, e.g. 20 to 60. 0 simulates once per frame."));
+
+static TAutoConsoleVariable<bool> CVarGeometryInterpolate(
+	TEXT("geometry.Movement.Interpolate"),
+	true,
+	TEXT("If true, the fixed-step movement interpolates every frame between the last two steps, ")
+	TEXT("otherwise the actors only move when a step is simulated."));
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+FGeometrySignificanceSettings::FGeometrySignificanceSettings()
+{
+	Buckets = {{2500.0f, 0.0f}, {10000.0f, 0.1f}, {50000.0f, 0.5f}};
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryMovementSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+#if DO_CHECK
+	// The vectorized sin is an approximation, make sure it still matches FMath::Sin on this platform
+	float MaxError = 0.0f;
+	ensureMsgf(GeometryKernels::ValidateSinKernel(MaxError), TEXT("Sin kernel error %f exceeds the bound %f"), MaxError,
+	           GeometryKernels::SinAccuracyBound);
+	UE_LOG(LogGeometryMovement, Verbose, TEXT("Sin kernel max error: %g"), MaxError);
+#endif
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryMovementSubsystem::Deinitialize()
+{
+	for (ABaseGeometryActor* Actor : Actors)
+	{
+		if (Actor)
+		{
+			Actor->MovementIndex = INDEX_NONE;
+		}
+	}
+
+	for (FGeometryMovementGroup& Group : Groups)
+	{
+		for (ABaseGeometryActor* Actor : Group.Actors)
+		{
+			if (Actor)
+			{
+				Actor->MovementGroup = INDEX_NONE;
+				Actor->MovementGroupIndex = INDEX_NONE;
+			}
+		}
+	}
+
+	for (ABaseGeometryActor* Actor : TickingActors)
+	{
+		if (Actor)
+		{
+			Actor->TickingIndex = INDEX_NONE;
+		}
+	}
+
+	Actors.Reset();
+	InitialLocations.Reset();
+	Amplitudes.Reset();
+	Frequencies.Reset();
+	Buckets.Reset();
+	NextUpdateTimes.Reset();
+	LastZ.Reset();
+	BlendStartTimes.Reset();
+	BlendStartZ.Reset();
+	PrevZ.Reset();
+	StepIndices.Reset();
+	Groups.Reset();
+	TickingActors.Reset();
+	TickingBuckets.Reset();
+	DueIndices.Reset();
+	FullUpdates.Reset();
+	DueAmplitudes.Reset();
+	DueFrequencies.Reset();
+	Offsets.Reset();
+	NewLocations.Reset();
+
+	Super::Deinitialize();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+TStatId UGeometryMovementSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UGeometryMovementSubsystem, STATGROUP_Tickables);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryMovementSubsystem::RegisterActor(ABaseGeometryActor* Actor)
+{
+	if (!Actor || Actor->MovementIndex != INDEX_NONE)
+		return;
+
+	const FGeometryData& Data = Actor->GeometryData;
+
+	Actor->MovementIndex = Actors.Add(Actor);
+	InitialLocations.Add(Actor->Initiallocation);
+	Amplitudes.Add(Data.Amplitude);
+	Frequencies.Add(Data.Frequency);
+	// Starts in the nearest bucket, the next significance update moves it where it belongs
+	Buckets.Add(0);
+	NextUpdateTimes.Add(0.0f);
+	LastZ.Add(Actor->Initiallocation.Z);
+	BlendStartTimes.Add(-MAX_flt);
+	BlendStartZ.Add(Actor->Initiallocation.Z);
+	PrevZ.Add(Actor->Initiallocation.Z);
+
+	// The subsystem drives the movement from now on, the actor does not need its own tick
+	Actor->SetActorTickEnabled(false);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryMovementSubsystem::UnregisterActor(ABaseGeometryActor* Actor)
+{
+	if (!Actor || !Actors.IsValidIndex(Actor->MovementIndex) || Actors[Actor->MovementIndex] != Actor)
+		return;
+
+	const int32 Index = Actor->MovementIndex;
+
+	Actors.RemoveAtSwap(Index, 1, false);
+	InitialLocations.RemoveAtSwap(Index, 1, false);
+	Amplitudes.RemoveAtSwap(Index, 1, false);
+	Frequencies.RemoveAtSwap(Index, 1, false);
+	Buckets.RemoveAtSwap(Index, 1, false);
+	NextUpdateTimes.RemoveAtSwap(Index, 1, false);
+	LastZ.RemoveAtSwap(Index, 1, false);
+	BlendStartTimes.RemoveAtSwap(Index, 1, false);
+	BlendStartZ.RemoveAtSwap(Index, 1, false);
+	PrevZ.RemoveAtSwap(Index, 1, false);
+
+	// The last actor has been moved into the freed slot, so its index must be patched
+	if (Actors.IsValidIndex(Index) && Actors[Index])
+	{
+		Actors[Index]->MovementIndex = Index;
+	}
+
+	Actor->MovementIndex = INDEX_NONE;
+	Actor->SetActorTickEnabled(true);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryMovementSubsystem::RegisterGroupActor(ABaseGeometryActor* Actor)
+{
+	if (!Actor || Actor->MovementGroup != INDEX_NONE)
+		return;
+
+	const FGeometryData& Data = Actor->GeometryData;
+	const FGeometryMovementModel* Model = GeometryMovement::FindModel(Data.MoveType);
+	if (!Model)
+		return;
+
+	const int32 GroupIndex = static_cast<int32>(Data.MoveType);
+	if (!Groups.IsValidIndex(GroupIndex))
+	{
+		Groups.SetNum(GeometryMovement::MaxMovementTypes);
+	}
+
+	FGeometryMovementGroup& Group = Groups[GroupIndex];
+	// The registry slot of the type, a model bound again by game code applies to the whole group at once
+	Group.Model = Model;
+
+	Actor->MovementGroup = GroupIndex;
+	Actor->MovementGroupIndex = Group.Actors.Add(Actor);
+	Group.InitialLocations.Add(Actor->Initiallocation);
+	Group.Amplitudes.Add(Data.Amplitude);
+	Group.Frequencies.Add(Data.Frequency);
+	Group.Buckets.Add(0);
+	Group.NextUpdateTimes.Add(0.0f);
+	Group.BlendStartTimes.Add(-MAX_flt);
+	Group.BlendStartLocations.Add(Actor->Initiallocation);
+
+	Actor->SetActorTickEnabled(false);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryMovementSubsystem::UnregisterGroupActor(ABaseGeometryActor* Actor)
+{
+	if (!Actor || !Groups.IsValidIndex(Actor->MovementGroup))
+		return;
+
+	FGeometryMovementGroup& Group = Groups[Actor->MovementGroup];
+	const int32 Index = Actor->MovementGroupIndex;
+	if (!Group.Actors.IsValidIndex(Index) || Group.Actors[Index] != Actor)
+		return;
+
+	Group.Actors.RemoveAtSwap(Index, 1, false);
+	Group.InitialLocations.RemoveAtSwap(Index, 1, false);
+	Group.Amplitudes.RemoveAtSwap(Index, 1, false);
+	Group.Frequencies.RemoveAtSwap(Index, 1, false);
+	Group.Buckets.RemoveAtSwap(Index, 1, false);
+	Group.NextUpdateTimes.RemoveAtSwap(Index, 1, false);
+	Group.BlendStartTimes.RemoveAtSwap(Index, 1, false);
+	Group.BlendStartLocations.RemoveAtSwap(Index, 1, false);
+
+	if (Group.Actors.IsValidIndex(Index) && Group.Actors[Index])
+	{
+		Group.Actors[Index]->MovementGroupIndex = Index;
+	}
+
+	Actor->MovementGroup = INDEX_NONE;
+	Actor->MovementGroupIndex = INDEX_NONE;
+	Actor->SetActorTickEnabled(true);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryMovementSubsystem::RegisterTickingActor(ABaseGeometryActor* Actor)
+{
+	if (!Actor || Actor->TickingIndex != INDEX_NONE)
+		return;
+
+	Actor->TickingIndex = TickingActors.Add(Actor);
+	TickingBuckets.Add(0);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryMovementSubsystem::UnregisterTickingActor(ABaseGeometryActor* Actor)
+{
+	if (!Actor || !TickingActors.IsValidIndex(Actor->TickingIndex) || TickingActors[Actor->TickingIndex] != Actor)
+		return;
+
+	const int32 Index = Actor->TickingIndex;
+
+	TickingActors.RemoveAtSwap(Index, 1, false);
+	TickingBuckets.RemoveAtSwap(Index, 1, false);
+
+	if (TickingActors.IsValidIndex(Index) && TickingActors[Index])
+	{
+		TickingActors[Index]->TickingIndex = Index;
+	}
+
+	// Back to the full tick rate
+	Actor->TickingIndex = INDEX_NONE;
+	Actor->SetActorTickInterval(0.0f);
+	Actor->SetActorTickEnabled(true);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryMovementSubsystem::SetSignificanceSettings(const FGeometrySignificanceSettings& InSettings)
+{
+	SignificanceSettings = InSettings;
+
+	FGeometrySignificanceSettings& Settings = SignificanceSettings;
+	Settings.Buckets.Sort([](const FGeometrySignificanceBucket& A, const FGeometrySignificanceBucket& B) { return A.MaxDistance < B.MaxDistance; });
+	if (Settings.Buckets.Num() > MaxSignificanceBuckets)
+	{
+		UE_LOG(LogGeometryMovement, Warning, TEXT("Only the first %d significance buckets are used"), MaxSignificanceBuckets);
+		Settings.Buckets.SetNum(MaxSignificanceBuckets);
+	}
+	Settings.OutOfViewDistanceScale = FMath::Max(Settings.OutOfViewDistanceScale, 1.0f);
+
+	// Re-evaluated with the new buckets on the next update
+	NextSignificanceTime = 0.0f;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryMovementSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	const float Time = GeometryKernels::GetMovementTime(GetWorld());
+	if (CVarGeometrySignificance.GetValueOnGameThread() && Time >= NextSignificanceTime)
+	{
+		UpdateSignificance(Time);
+		NextSignificanceTime = Time + SignificanceSettings.EvaluationInterval;
+	}
+
+	const bool bParallel = CVarGeometryParallelMovement.GetValueOnGameThread();
+	UpdateGroups(Time, bParallel);
+	UpdateThrottledTickingActors(Time);
+
+	const float FixedStepRate = CVarGeometryFixedStepRate.GetValueOnGameThread();
+	if (FixedStepRate > 0.0f)
+	{
+		UpdateFixedStep(Time, FixedStepRate, bParallel);
+		return;
+	}
+
+	// A later switch to fixed steps starts from the current time
+	ResetFixedStep();
+	UpdateMovement(Time, bParallel);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryMovementSubsystem::UpdateSignificance(float Time)
+{
+	SCOPE_CYCLE_COUNTER(STAT_GeometrySignificance);
+	TRACE_CPUPROFILER_EVENT_SCOPE(UGeometryMovementSubsystem::UpdateSignificance);
+
+	FSignificanceView View;
+	const APlayerController* PlayerController = GetWorld()->GetFirstPlayerController();
+	if (PlayerController && PlayerController->PlayerCameraManager)
+	{
+		const APlayerCameraManager* CameraManager = PlayerController->PlayerCameraManager;
+		View.bValid = true;
+		View.Location = CameraManager->GetCameraLocation();
+		View.Direction = CameraManager->GetCameraRotation().Vector();
+		View.CosHalfFov = FMath::Cos(FMath::DegreesToRadians(CameraManager->GetFOVAngle() * 0.5f));
+	}
+
+	int32 BucketCounts[MaxSignificanceBuckets + 1] = {};
+
+	for (int32 i = 0; i < Actors.Num(); ++i)
+	{
+		const uint8 Bucket = ComputeBucket(View, InitialLocations[i]);
+		++BucketCounts[Bucket];
+		if (Bucket == Buckets[i])
+			continue;
+
+		// Start from where the actor was left, so a bucket change never makes it jump
+		Buckets[i] = Bucket;
+		BlendStartTimes[i] = Time;
+		BlendStartZ[i] = LastZ[i];
+
+		// Updated right away, the next updates are staggered over the interval so a bucket doesn't update all at once
+		const float Interval = GetUpdateInterval(Bucket);
+		NextUpdateTimes[i] = Interval < 0.0f ? MAX_flt : Time;
+	}
+
+	for (FGeometryMovementGroup& Group : Groups)
+	{
+		for (int32 i = 0; i < Group.Actors.Num(); ++i)
+		{
+			const uint8 Bucket = ComputeBucket(View, Group.InitialLocations[i]);
+			++BucketCounts[Bucket];
+			if (Bucket == Group.Buckets[i])
+				continue;
+
+			// The models move in X and Y too, the blend starts from the whole location
+			const ABaseGeometryActor* Actor = Group.Actors[i];
+			Group.Buckets[i] = Bucket;
+			Group.BlendStartTimes[i] = Time;
+			Group.BlendStartLocations[i] = Actor ? Actor->GetActorLocation() : Group.InitialLocations[i];
+
+			const float Interval = GetUpdateInterval(Bucket);
+			Group.NextUpdateTimes[i] = Interval < 0.0f ? MAX_flt : Time;
+		}
+	}
+
+	for (int32 i = 0; i < TickingActors.Num(); ++i)
+	{
+		ABaseGeometryActor* Actor = TickingActors[i];
+		const uint8 Bucket = Actor ? ComputeBucket(View, Actor->GetActorLocation()) : 0;
+		++BucketCounts[Bucket];
+		if (!Actor || Bucket == TickingBuckets[i])
+			continue;
+
+		TickingBuckets[i] = Bucket;
+		const float Interval = GetUpdateInterval(Bucket);
+		Actor->SetActorTickEnabled(Interval >= 0.0f);
+		Actor->SetActorTickInterval(FMath::Max(Interval, 0.0f));
+	}
+
+	// The count after the last configured bucket is the frozen one
+	const int32 NumBuckets = SignificanceSettings.Buckets.Num();
+	const auto GetBucketCount = [&BucketCounts, NumBuckets](int32 Bucket) { return Bucket < NumBuckets ? BucketCounts[Bucket] : 0; };
+	SET_DWORD_STAT(STAT_GeometrySignificanceBucket0, GetBucketCount(0));
+	SET_DWORD_STAT(STAT_GeometrySignificanceBucket1, GetBucketCount(1));
+	SET_DWORD_STAT(STAT_GeometrySignificanceBucket2, GetBucketCount(2));
+	SET_DWORD_STAT(STAT_GeometrySignificanceBucket3, GetBucketCount(3));
+	SET_DWORD_STAT(STAT_GeometrySignificanceFrozen, BucketCounts[NumBuckets]);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+uint8 UGeometryMovementSubsystem::ComputeBucket(const FSignificanceView& View, const FVector& Location) const
+{
+	// Without a camera everything is significant
+	if (!View.bValid)
+		return 0;
+
+	const FVector ToActor = Location - View.Location;
+	float DistanceSquared = ToActor.SizeSquared();
+	if ((ToActor | View.Direction) < View.CosHalfFov * FMath::Sqrt(DistanceSquared))
+	{
+		DistanceSquared *= FMath::Square(SignificanceSettings.OutOfViewDistanceScale);
+	}
+
+	const TArray<FGeometrySignificanceBucket>& SignificanceBuckets = SignificanceSettings.Buckets;
+	for (int32 Bucket = 0; Bucket < SignificanceBuckets.Num(); ++Bucket)
+	{
+		if (DistanceSquared <= FMath::Square(SignificanceBuckets[Bucket].MaxDistance))
+			return static_cast<uint8>(Bucket);
+	}
+	return static_cast<uint8>(SignificanceBuckets.Num());
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+float UGeometryMovementSubsystem::GetUpdateInterval(uint8 Bucket) const
+{
+	const TArray<FGeometrySignificanceBucket>& SignificanceBuckets = SignificanceSettings.Buckets;
+	return SignificanceBuckets.IsValidIndex(Bucket) ? SignificanceBuckets[Bucket].UpdateInterval : -1.0f;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+float UGeometryMovementSubsystem::GetNextUpdateTime(int32 Index, float Time, float Interval)
+{
+	// Between 0.5 and 1.5 intervals, the golden ratio spreads the actors of a bucket so they don't all update in the same frame
+	return Interval > 0.0f ? Time + Interval * FMath::Frac(Index * 0.618034f + 0.5f) + Interval * 0.5f : Time;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryMovementSubsystem::CollectDueActors(float Time, bool bUseSignificance)
+{
+	const int32 Num = Actors.Num();
+	DueIndices.Reset(Num);
+	FullUpdates.Reset();
+	DueAmplitudes.Reset(Num);
+	DueFrequencies.Reset(Num);
+
+	for (int32 i = 0; i < Num; ++i)
+	{
+		// The Sin is cheap enough for every actor every frame, only the full update of SetActorLocation is throttled
+		bool bFullUpdate = true;
+		if (bUseSignificance)
+		{
+			const float Interval = GetUpdateInterval(Buckets[i]);
+			if (Interval < 0.0f)
+				continue;
+
+			bFullUpdate = NextUpdateTimes[i] <= Time;
+			if (bFullUpdate)
+			{
+				NextUpdateTimes[i] = GetNextUpdateTime(i, Time, Interval);
+			}
+		}
+
+		DueIndices.Add(i);
+		FullUpdates.Add(bFullUpdate);
+		DueAmplitudes.Add(Amplitudes[i]);
+		DueFrequencies.Add(Frequencies[i]);
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+static void SetGeometryLocation(ABaseGeometryActor* Actor, const FVector& Location, bool bBulk)
+{
+	USceneComponent* Root = Actor ? Actor->GetRootComponent() : nullptr;
+	if (!Root)
+		return;
+
+	// Relative and world space differ for attached roots, they take the regular path
+	if (!bBulk || Root->GetAttachParent())
+	{
+		Actor->SetActorLocation(Location);
+		return;
+	}
+
+	// The root transform is written directly and only the component transform is refreshed: no sweep, overlap or
+	// physics update per actor. Each primitive is still marked render-transform dirty on its own, there is no batch of
+	// ours here: the engine queues the components and sends their transforms in its end of frame update.
+	Root->SetRelativeLocation_Direct(Location);
+	Root->UpdateComponentToWorld(EUpdateTransformFlags::SkipPhysicsUpdate, ETeleportType::TeleportPhysics);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryMovementSubsystem::UpdateThrottledTickingActors(float Time)
+{
+	if (!CVarGeometrySignificance.GetValueOnGameThread())
+		return;
+
+	for (int32 i = 0; i < TickingActors.Num(); ++i)
+	{
+		// Their own tick keeps doing the full update at the interval of the bucket
+		ABaseGeometryActor* Actor = TickingActors[i];
+		if (!Actor || GetUpdateInterval(TickingBuckets[i]) <= 0.0f || !GeometryMovement::IsMoving(Actor->GetGeometryData().MoveType))
+			continue;
+
+		SetGeometryLocation(Actor, Actor->GetGeometryLocationAtTime(Time), true);
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryMovementSubsystem::UpdateMovement(float Time, bool bParallel)
+{
+	if (Actors.Num() == 0)
+		return;
+
+	SCOPE_CYCLE_COUNTER(STAT_GeometryBatchedMovement);
+	TRACE_CPUPROFILER_EVENT_SCOPE(UGeometryMovementSubsystem::UpdateMovement);
+
+	// Only the actors whose bucket is due this frame, gathered into contiguous buffers for the kernel
+	CollectDueActors(Time, CVarGeometrySignificance.GetValueOnGameThread());
+	const int32 Num = DueIndices.Num();
+	if (Num == 0)
+		return;
+
+	INC_DWORD_STAT_BY(STAT_GeometryBatchedMovementActors, Num);
+
+	if (bParallel)
+	{
+		UpdateMovementParallel(Time);
+		return;
+	}
+
+	// Pass 1: evaluate all the offsets in one tight loop over contiguous memory
+	Offsets.SetNumUninitialized(Num, false);
+	float* OffsetData = Offsets.GetData();
+	GeometryKernels::ComputeSinOffsets(DueAmplitudes.GetData(), DueFrequencies.GetData(), Time, OffsetData, Num);
+
+	// Pass 2: push the results to the actors
+	for (int32 DueIndex = 0; DueIndex < Num; ++DueIndex)
+	{
+		const int32 i = DueIndices[DueIndex];
+		ABaseGeometryActor* Actor = Actors[i];
+		if (!Actor)
+			continue;
+
+		FVector CurrentLocation = Actor->GetActorLocation();
+		CurrentLocation.Z = ResolveZ(i, OffsetData[DueIndex], Time);
+		SetGeometryLocation(Actor, CurrentLocation, !FullUpdates[DueIndex]);
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryMovementSubsystem::UpdateMovementParallel(float Time)
+{
+	const int32 Num = DueIndices.Num();
+	const int32 ChunkSize = FMath::Max(CVarGeometryParallelChunkSize.GetValueOnGameThread(), 1);
+	const int32 NumChunks = FMath::DivideAndRoundUp(Num, ChunkSize);
+
+	Offsets.SetNumUninitialized(Num, false);
+	NewLocations.SetNumUninitialized(Num, false);
+
+	// Phase 1 (worker threads): every chunk evaluates its offsets and builds the new locations.
+	// Nothing writes to the actors in this phase, so reading their current location is safe.
+	ParallelFor(NumChunks, [this, Time, Num, ChunkSize](int32 ChunkIndex)
+	{
+		const int32 Start = ChunkIndex * ChunkSize;
+		const int32 Count = FMath::Min(ChunkSize, Num - Start);
+
+		GeometryKernels::ComputeSinOffsets(DueAmplitudes.GetData() + Start, DueFrequencies.GetData() + Start, Time, Offsets.GetData() + Start, Count);
+
+		for (int32 DueIndex = Start; DueIndex < Start + Count; ++DueIndex)
+		{
+			const int32 i = DueIndices[DueIndex];
+			const ABaseGeometryActor* Actor = Actors[i];
+			FVector Location = Actor ? Actor->GetActorLocation() : InitialLocations[i];
+			Location.Z = ResolveZ(i, Offsets[DueIndex], Time);
+			NewLocations[DueIndex] = Location;
+		}
+	});
+
+	// Phase 2 (game thread): commit the locations in bulk
+	CommitLocations(DueIndices, true);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryMovementSubsystem::CommitLocations(const TArray<int32>& Indices, bool bBulk, const TBitArray<>* FullUpdateMask)
+{
+	for (int32 Index = 0; Index < Indices.Num(); ++Index)
+	{
+		if (Actors.IsValidIndex(Indices[Index]))
+		{
+			SetGeometryLocation(Actors[Indices[Index]], NewLocations[Index], bBulk || (FullUpdateMask && !(*FullUpdateMask)[Index]));
+		}
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryMovementSubsystem::UpdateGroups(float Time, bool bParallel)
+{
+	SCOPE_CYCLE_COUNTER(STAT_GeometryGroupMovement);
+	TRACE_CPUPROFILER_EVENT_SCOPE(UGeometryMovementSubsystem::UpdateGroups);
+
+	const int32 ChunkSize = FMath::Max(CVarGeometryParallelChunkSize.GetValueOnGameThread(), 1);
+	const bool bUseSignificance = CVarGeometrySignificance.GetValueOnGameThread();
+	const float BlendTime = SignificanceSettings.BlendTime;
+
+	for (FGeometryMovementGroup& Group : Groups)
+	{
+		const int32 Num = Group.Actors.Num();
+		if (Num == 0 || !Group.Model)
+			continue;
+
+		INC_DWORD_STAT_BY(STAT_GeometryBatchedMovementActors, Num);
+
+		// One indirect call per chunk, the loop inside is compiled for this model only
+		Group.Locations.SetNumUninitialized(Num, false);
+		const int32 NumChunks = FMath::DivideAndRoundUp(Num, ChunkSize);
+		ParallelFor(NumChunks, [&Group, Time, Num, ChunkSize](int32 ChunkIndex)
+		{
+			const int32 Start = ChunkIndex * ChunkSize;
+			Group.Model->UpdateBatch(Group.InitialLocations.GetData() + Start, Group.Amplitudes.GetData() + Start, Group.Frequencies.GetData() + Start,
+			                         Time, Group.Locations.GetData() + Start, FMath::Min(ChunkSize, Num - Start));
+		}, !bParallel);
+
+		// Same buckets as the Sin actors: every actor which isn't frozen follows its curve, the full update waits for its interval
+		for (int32 i = 0; i < Num; ++i)
+		{
+			bool bFullUpdate = true;
+			FVector Location = Group.Locations[i];
+			if (bUseSignificance)
+			{
+				const float Interval = GetUpdateInterval(Group.Buckets[i]);
+				if (Interval < 0.0f)
+					continue;
+
+				bFullUpdate = Group.NextUpdateTimes[i] <= Time;
+				if (bFullUpdate)
+				{
+					Group.NextUpdateTimes[i] = GetNextUpdateTime(i, Time, Interval);
+				}
+
+				const float BlendAlpha = BlendTime > 0.0f ? (Time - Group.BlendStartTimes[i]) / BlendTime : 1.0f;
+				if (BlendAlpha >= 0.0f && BlendAlpha < 1.0f)
+				{
+					Location = FMath::Lerp(Group.BlendStartLocations[i], Location, FMath::SmoothStep(0.0f, 1.0f, BlendAlpha));
+				}
+			}
+
+			SetGeometryLocation(Group.Actors[i], Location, bParallel || !bFullUpdate);
+		}
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryMovementSubsystem::UpdateFixedStep(float Time, float StepRate, bool bParallel)
+{
+	if (Actors.Num() == 0)
+		return;
+
+	SCOPE_CYCLE_COUNTER(STAT_GeometryBatchedMovement);
+	TRACE_CPUPROFILER_EVENT_SCOPE(UGeometryMovementSubsystem::UpdateFixedStep);
+
+	const float StepLength = 1.0f / FMath::Max(StepRate, 1.0f);
+
+	// First update, new rate or time going backwards: the sequence starts with a step at Time
+	if (FixedStepTime < 0.0f || Time < FixedStepTime || StepLength != FixedStepLength)
+	{
+		FixedStepLength = StepLength;
+		FixedStepTime = Time;
+		SimulateStep(Time);
+		INC_DWORD_STAT(STAT_GeometryFixedSteps);
+	}
+
+	const int32 NumSteps = FMath::FloorToInt((Time - FixedStepTime) / StepLength);
+	if (NumSteps > 0)
+	{
+		FixedStepTime += NumSteps * StepLength;
+
+		// Interpolation only needs the last two states and the Sin motion has no state, so missed steps are skipped
+		if (NumSteps > 1)
+		{
+			SimulateStep(FixedStepTime - StepLength);
+		}
+		SimulateStep(FixedStepTime);
+		INC_DWORD_STAT_BY(STAT_GeometryFixedSteps, FMath::Min(NumSteps, 2));
+	}
+
+	if (CVarGeometryInterpolate.GetValueOnGameThread())
+	{
+		ApplyInterpolation(FMath::Clamp((Time - FixedStepTime) / StepLength, 0.0f, 1.0f), bParallel);
+	}
+	else if (NumSteps > 0)
+	{
+		ApplyInterpolation(1.0f, bParallel);
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryMovementSubsystem::SimulateStep(float StepTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_GeometryFixedStepSimulate);
+	TRACE_CPUPROFILER_EVENT_SCOPE(UGeometryMovementSubsystem::SimulateStep);
+
+	CollectDueActors(StepTime, CVarGeometrySignificance.GetValueOnGameThread());
+	const int32 Num = DueIndices.Num();
+	INC_DWORD_STAT_BY(STAT_GeometryBatchedMovementActors, Num);
+
+	Offsets.SetNumUninitialized(Num, false);
+	GeometryKernels::ComputeSinOffsets(DueAmplitudes.GetData(), DueFrequencies.GetData(), StepTime, Offsets.GetData(), Num);
+
+	// Only the simulation state changes, the actors are moved by ApplyInterpolation
+	for (int32 DueIndex = 0; DueIndex < Num; ++DueIndex)
+	{
+		const int32 i = DueIndices[DueIndex];
+		PrevZ[i] = LastZ[i];
+		ResolveZ(i, Offsets[DueIndex], StepTime);
+	}
+
+	// Every actor which isn't frozen is interpolated
+	Swap(StepIndices, DueIndices);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryMovementSubsystem::ApplyInterpolation(float Alpha, bool bParallel)
+{
+	SCOPE_CYCLE_COUNTER(STAT_GeometryFixedStepInterpolate);
+	TRACE_CPUPROFILER_EVENT_SCOPE(UGeometryMovementSubsystem::ApplyInterpolation);
+
+	const int32 Num = StepIndices.Num();
+	NewLocations.SetNumUninitialized(Num, false);
+
+	// The Sin motion only moves Z, X and Y come from the SoA buffers instead of the actors
+	ParallelFor(Num, [this, Alpha](int32 Index)
+	{
+		const int32 i = StepIndices[Index];
+		if (!Actors.IsValidIndex(i))
+			return;
+
+		FVector Location = InitialLocations[i];
+		Location.Z = FMath::Lerp(PrevZ[i], LastZ[i], Alpha);
+		NewLocations[Index] = Location;
+	}, !bParallel);
+
+	// Several times per step, a sweep per actor would cost more than the whole interpolation
+	CommitLocations(StepIndices, true);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+// Spawns N Sin-mode geometry actors for each N in the list and compares the serial and the parallel update, then the CPU time
+// of one second of game time at 60, 144 and 240 FPS with the per-frame and the fixed-step update.
+// Usage: geometry.Movement.Benchmark [NumFrames]
+static FAutoConsoleCommandWithWorldAndArgs GGeometryMovementBenchmarkCommand(
+	TEXT("geometry.Movement.Benchmark"),
+	TEXT("Compares the serial and the parallel geometry movement update at 1k, 10k and 100k actors, ")
+	TEXT("and the per-frame and the fixed-step update at 60, 144 and 240 FPS."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		UGeometryMovementSubsystem* MovementSubsystem = World ? World->GetSubsystem<UGeometryMovementSubsystem>() : nullptr;
+		if (!MovementSubsystem)
+			return;
+
+		const int32 NumFrames = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 60;
+		const int32 ActorCounts[] = {1000, 10000, 100000};
+
+		for (const int32 NumActors : ActorCounts)
+		{
+			TArray<ABaseGeometryActor*> Spawned;
+			Spawned.Reserve(NumActors);
+
+			for (int32 i = 0; i < NumActors; ++i)
+			{
+				const FTransform Transform(FVector(300.0f * (i % 1000), 300.0f * (i / 1000), 330.0f));
+				ABaseGeometryActor* Geometry = World->SpawnActorDeferred<ABaseGeometryActor>(ABaseGeometryActor::StaticClass(), Transform);
+				if (Geometry)
+				{
+					FGeometryData Data;
+					Data.MoveType = EMovementType::Sin;
+					Data.Frequency = 1.0f + (i % 7);
+					Geometry->SetGeometryData(Data);
+					Geometry->FinishSpawning(Transform);
+					Spawned.Add(Geometry);
+				}
+			}
+
+			double Seconds[2] = {0.0, 0.0};
+			for (int32 Mode = 0; Mode < 2; ++Mode)
+			{
+				const double StartTime = FPlatformTime::Seconds();
+				for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+				{
+					MovementSubsystem->UpdateMovement(Frame / 60.0f, Mode == 1);
+				}
+				Seconds[Mode] = FPlatformTime::Seconds() - StartTime;
+			}
+
+			UE_LOG(LogGeometryMovement, Display, TEXT("%7d actors: serial %.3f ms/frame, parallel %.3f ms/frame"), MovementSubsystem->GetNumRegistered(),
+			       Seconds[0] * 1000.0 / NumFrames, Seconds[1] * 1000.0 / NumFrames);
+
+			// CPU time per second of game time. The per-frame update evaluates every actor every frame, the fixed-step update
+			// simulates StepRate times per second and only interpolates per frame (nothing with geometry.Movement.Interpolate 0)
+			const float CVarStepRate = CVarGeometryFixedStepRate.GetValueOnGameThread();
+			const float StepRate = CVarStepRate > 0.0f ? CVarStepRate : 30.0f;
+			for (const int32 FramesPerSecond : {60, 144, 240})
+			{
+				double StartTime = FPlatformTime::Seconds();
+				for (int32 Frame = 0; Frame < FramesPerSecond; ++Frame)
+				{
+					MovementSubsystem->UpdateMovement(static_cast<float>(Frame) / FramesPerSecond, false);
+				}
+				const double PerFrameMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+				MovementSubsystem->ResetFixedStep();
+				StartTime = FPlatformTime::Seconds();
+				for (int32 Frame = 0; Frame < FramesPerSecond; ++Frame)
+				{
+					MovementSubsystem->UpdateFixedStep(static_cast<float>(Frame) / FramesPerSecond, StepRate, false);
+				}
+				const double FixedStepMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+				MovementSubsystem->ResetFixedStep();
+
+				UE_LOG(LogGeometryMovement, Display, TEXT("%7d actors at %3d FPS: per frame %.2f ms/s, fixed step %.0f Hz %.2f ms/s"),
+				       MovementSubsystem->GetNumRegistered(), FramesPerSecond, PerFrameMs, StepRate, FixedStepMs);
+			}
+
+			for (ABaseGeometryActor* Geometry : Spawned)
+			{
+				Geometry->Destroy();
+			}
+		}
+	}));
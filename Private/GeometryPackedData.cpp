@@ -0,0 +1,258 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GeometryPackedData.h"
+#include "GeometryBenchmarkSubsystem.h"
+#include "GeometryLayoutFile.h"
+#include "GeometryRandom.h"
+#include "HAL/IConsoleManager.h"
+#include "EngineUtils.h"
+#include "Engine/World.h"
+#include "Serialization/BitWriter.h"
+#include "UObject/UnrealType.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogGeometryPacking, All, All)
+
+// Largest finite half float
+static constexpr float MaxHalf = 65504.0f;
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+static FFloat16 PackHalf(float Value)
+{
+	// NaN would not survive the comparisons of the round-trip check, it packs as 0
+	return FFloat16(FMath::IsNaN(Value) ? 0.0f : FMath::Clamp(Value, -MaxHalf, MaxHalf));
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void FPackedGeometryData::Pack(const FGeometryData& Data)
+{
+	// Linear quantization, ToFColor(true) would apply the sRGB curve and not be idempotent with ReinterpretAsLinear
+	Color = Data.Color.QuantizeRound();
+	Amplitude = PackHalf(Data.Amplitude);
+	Frequency = PackHalf(Data.Frequency);
+	TimeRate = PackHalf(Data.TimeRate);
+	Flags = static_cast<uint8>(Data.MoveType) & MoveTypeMask;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+FGeometryData FPackedGeometryData::Unpack() const
+{
+	FGeometryData Data;
+	Data.Amplitude = Amplitude.GetFloat();
+	Data.Frequency = Frequency.GetFloat();
+	Data.MoveType = GetMoveType();
+	Data.Color = Color.ReinterpretAsLinear();
+	Data.TimeRate = TimeRate.GetFloat();
+	return Data;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+bool FPackedGeometryData::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+	Ar << Color;
+	Ar << Amplitude;
+	Ar << Frequency;
+	Ar << TimeRate;
+
+	uint8 MoveTypeValue = Flags & MoveTypeMask;
+	Ar.SerializeBits(&MoveTypeValue, MoveTypeBits);
+	if (Ar.IsLoading())
+	{
+		Flags = MoveTypeValue & MoveTypeMask;
+	}
+
+	bOutSuccess = !Ar.IsError();
+	return true;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+// Largest error of a half float against the clamped source value: half an ulp of the 11 bit mantissa, or of the smallest subnormal
+static bool IsWithinHalfPrecision(float Source, float Unpacked)
+{
+	const float Clamped = FMath::Clamp(Source, -MaxHalf, MaxHalf);
+	const float Tolerance = FMath::Max(FMath::Abs(Clamped) * (1.0f / 2048.0f), 1.0f / 33554432.0f);
+	return FMath::Abs(Clamped - Unpacked) <= Tolerance;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+static bool IsWithinColorPrecision(float Source, float Unpacked)
+{
+	return FMath::Abs(FMath::Clamp(Source, 0.0f, 1.0f) - Unpacked) <= 0.5f / 255.0f + KINDA_SMALL_NUMBER;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+static FString DescribeData(const FGeometryData& Data)
+{
+	return FString::Printf(TEXT("Amplitude %g, Frequency %g, TimeRate %g, MoveType %d, Color %s"), Data.Amplitude, Data.Frequency, Data.TimeRate,
+	                       static_cast<int32>(Data.MoveType), *Data.Color.ToString());
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+static bool ValidateSample(const FGeometryData& Source, FString& OutError)
+{
+	const FPackedGeometryData Packed(Source);
+	const FGeometryData Unpacked = Packed.Unpack();
+
+	// 1. Lossless on the packed form: packing the unpacked data gives the same bits
+	if (FPackedGeometryData(Unpacked) != Packed)
+	{
+		OutError = FString::Printf(TEXT("Second round trip changed the packed data of %s"), *DescribeData(Source));
+		return false;
+	}
+
+	// 2. Lossless on the quantized editor data: every field comes back exactly
+	const FGeometryData Requantized = FPackedGeometryData(Unpacked).Unpack();
+	if (Requantized.Amplitude != Unpacked.Amplitude || Requantized.Frequency != Unpacked.Frequency || Requantized.TimeRate != Unpacked.TimeRate ||
+		Requantized.MoveType != Unpacked.MoveType || Requantized.Color != Unpacked.Color)
+	{
+		OutError = FString::Printf(TEXT("Quantized data %s doesn't round-trip exactly"), *DescribeData(Unpacked));
+		return false;
+	}
+
+	// 3. The loss of the first packing stays within the documented precision
+	if (Unpacked.MoveType != Source.MoveType ||
+		!IsWithinHalfPrecision(Source.Amplitude, Unpacked.Amplitude) || !IsWithinHalfPrecision(Source.Frequency, Unpacked.Frequency) ||
+		!IsWithinHalfPrecision(Source.TimeRate, Unpacked.TimeRate) ||
+		!IsWithinColorPrecision(Source.Color.R, Unpacked.Color.R) || !IsWithinColorPrecision(Source.Color.G, Unpacked.Color.G) ||
+		!IsWithinColorPrecision(Source.Color.B, Unpacked.Color.B) || !IsWithinColorPrecision(Source.Color.A, Unpacked.Color.A))
+	{
+		OutError = FString::Printf(TEXT("%s unpacked as %s"), *DescribeData(Source), *DescribeData(Unpacked));
+		return false;
+	}
+
+	return true;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+bool GeometryPacking::ValidateRoundTrip(int32 NumSamples, FString& OutError)
+{
+	TArray<FGeometryData> Samples;
+
+	// The defaults must come back unchanged, they are exactly representable
+	const FGeometryData Defaults;
+	Samples.Add(Defaults);
+
+	FGeometryData Limits;
+	Limits.Amplitude = MaxHalf;
+	Limits.Frequency = -MaxHalf;
+	Limits.TimeRate = 1.0e-7f;
+	Limits.MoveType = EMovementType::Sin;
+	Limits.Color = FLinearColor(1.0f, 0.0f, 0.5f, 1.0f);
+	Samples.Add(Limits);
+
+	// Out of range values are clamped
+	Limits.Amplitude = 1.0e6f;
+	Limits.Color = FLinearColor(4.0f, -1.0f, 0.0f, 2.0f);
+	Samples.Add(Limits);
+
+	// Every move type at least once, with negative values in every half float field
+	constexpr int32 NumMoveTypes = static_cast<int32>(EMovementType::Custom3) + 1;
+	for (int32 MoveType = 0; MoveType < NumMoveTypes; ++MoveType)
+	{
+		FGeometryData Data;
+		Data.Amplitude = -MaxHalf;
+		Data.Frequency = -2.5f;
+		Data.TimeRate = -0.75f;
+		Data.MoveType = static_cast<EMovementType>(MoveType);
+		Samples.Add(Data);
+	}
+
+	FGeometryRandomStream Stream(GeometryRandom::GetSeed(), 0x9AC4ED);
+	for (int32 i = 0; i < NumSamples; ++i)
+	{
+		FGeometryData Data;
+		Data.Amplitude = (Stream.NextFloat() * 2.0f - 1.0f) * 1000.0f;
+		Data.Frequency = (Stream.NextFloat() * 2.0f - 1.0f) * 20.0f;
+		Data.TimeRate = (Stream.NextFloat() * 2.0f - 1.0f) * 10.0f;
+		Data.MoveType = static_cast<EMovementType>(Stream.NextUInt() % NumMoveTypes);
+		Data.Color = FLinearColor(Stream.NextFloat(), Stream.NextFloat(), Stream.NextFloat(), Stream.NextFloat());
+		Samples.Add(Data);
+	}
+
+	for (const FGeometryData& Sample : Samples)
+	{
+		if (!ValidateSample(Sample, OutError))
+			return false;
+	}
+
+	const FGeometryData UnpackedDefaults = FPackedGeometryData::Quantize(Defaults);
+	if (UnpackedDefaults.Amplitude != Defaults.Amplitude || UnpackedDefaults.Frequency != Defaults.Frequency ||
+		UnpackedDefaults.TimeRate != Defaults.TimeRate || UnpackedDefaults.MoveType != Defaults.MoveType || UnpackedDefaults.Color != Defaults.Color)
+	{
+		OutError = FString::Printf(TEXT("Default data unpacked as %s"), *DescribeData(UnpackedDefaults));
+		return false;
+	}
+
+	return true;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+int64 GeometryPacking::GetNetSerializedBits(const FPackedGeometryData& Data)
+{
+	FBitWriter Writer(0, true);
+	bool bSuccess = false;
+	FPackedGeometryData(Data).NetSerialize(Writer, nullptr, bSuccess);
+	return Writer.GetNumBits();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+int32 GeometryPacking::GetEditorOnlyBytes(const UStruct* Struct)
+{
+	int32 Bytes = 0;
+	for (TFieldIterator<FProperty> It(Struct); It; ++It)
+	{
+		if (It->HasAnyPropertyFlags(CPF_EditorOnly))
+		{
+			Bytes += It->GetSize();
+		}
+	}
+	return Bytes;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+static FAutoConsoleCommandWithWorldAndArgs GGeometryPackedDataReportCommand(
+	TEXT("geometry.PackedData.Report"),
+	TEXT("Validates the round trip of FPackedGeometryData and logs the measured sizes of the editor-facing and the packed geometry data, ")
+	TEXT("and of the geometry actors of the world. ")
+	TEXT("Optional argument: number of random samples (default 10000)."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		const int32 NumSamples = Args.Num() > 0 ? FMath::Max(0, FCString::Atoi(*Args[0])) : 10000;
+
+		FString Error;
+		if (GeometryPacking::ValidateRoundTrip(NumSamples, Error))
+		{
+			UE_LOG(LogGeometryPacking, Display, TEXT("Round trip of %d samples passed"), NumSamples);
+		}
+		else
+		{
+			UE_LOG(LogGeometryPacking, Error, TEXT("Round trip failed: %s"), *Error);
+		}
+
+		UE_LOG(LogGeometryPacking, Display, TEXT("Geometry data: %d bytes editor-facing, %d bytes packed, %lld bits replicated"),
+		       static_cast<int32>(sizeof(FGeometryData)), static_cast<int32>(sizeof(FPackedGeometryData)),
+		       GeometryPacking::GetNetSerializedBits(FPackedGeometryData(FGeometryData())));
+		UE_LOG(LogGeometryPacking, Display, TEXT("Layout record: %d bytes"), static_cast<int32>(sizeof(FGeometryLayoutRecord)));
+
+		// 0 in cooked builds, the editor keeps the fields and their bytes in every actor
+		UE_LOG(LogGeometryPacking, Display, TEXT("Editor-only fields of a geometry actor in this build: %d bytes"),
+		       GeometryPacking::GetEditorOnlyBytes(ABaseGeometryActor::StaticClass()));
+
+		if (!World)
+			return;
+
+		int32 NumActors = 0;
+		SIZE_T ActorBytes = 0;
+		for (TActorIterator<ABaseGeometryActor> It(World); It; ++It)
+		{
+			++NumActors;
+			ActorBytes += UGeometryBenchmarkSubsystem::GetActorMemoryBytes(*It);
+		}
+
+		if (NumActors == 0)
+			return;
+
+		// Measured in this build, compare an editor and a cooked build for the editor-only fields
+		UE_LOG(LogGeometryPacking, Display, TEXT("%d geometry actors: %.0f bytes/actor with their components"), NumActors,
+		       static_cast<double>(ActorBytes) / NumActors);
+	}));
@@ -0,0 +1,44 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GeometryRandom.h"
+#include "Async/ParallelFor.h"
+#include "HAL/IConsoleManager.h"
+
+static TAutoConsoleVariable<int32> CVarGeometryRandomSeed(
+	TEXT("geometry.Random.Seed"),
+	0,
+	TEXT("Seed of all the geometry random streams. Runs with the same seed and the same spawn order produce the same colors and move types."));
+
+// Colors per stream in FillRandomColors, fixed so the result doesn't depend on the number of workers
+static constexpr int32 FillChunkSize = 4096;
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+uint64 GeometryRandom::GetSeed()
+{
+	return static_cast<uint32>(CVarGeometryRandomSeed.GetValueOnAnyThread());
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+FGeometryRandomStream GeometryRandom::MakeStream(uint64 Key)
+{
+	return FGeometryRandomStream(GetSeed(), Key);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void GeometryRandom::FillRandomColors(uint64 Seed, TArrayView<FLinearColor> OutColors)
+{
+	const int32 Num = OutColors.Num();
+	const int32 NumChunks = FMath::DivideAndRoundUp(Num, FillChunkSize);
+
+	ParallelFor(NumChunks, [Seed, OutColors, Num](int32 ChunkIndex)
+	{
+		FGeometryRandomStream Stream(Seed, ChunkIndex);
+
+		const int32 End = FMath::Min((ChunkIndex + 1) * FillChunkSize, Num);
+		for (int32 i = ChunkIndex * FillChunkSize; i < End; ++i)
+		{
+			OutColors[i] = Stream.NextColor();
+		}
+	});
+}
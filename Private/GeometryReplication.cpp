@@ -0,0 +1,119 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GeometryReplication.h"
+#include "GeometryHubActor.h"
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void FGeometryReplicatedItem::PostReplicatedAdd(const FGeometryReplicatedArray& Array)
+{
+	if (Array.Owner)
+	{
+		Array.Owner->SpawnReplicatedGeometry(*this);
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void FGeometryReplicatedItem::PostReplicatedChange(const FGeometryReplicatedArray& Array)
+{
+	// Only the color changes after the shape has been added
+	if (ABaseGeometryActor* Geometry = Actor.Get())
+	{
+		Geometry->ApplyReplicatedColor(Data.Color.ReinterpretAsLinear());
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void FGeometryReplicatedItem::PreReplicatedRemove(const FGeometryReplicatedArray& Array)
+{
+	if (Array.Owner)
+	{
+		Array.Owner->DestroyReplicatedGeometry(Actor.Get());
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void FGeometryReplicatedArray::Add(ABaseGeometryActor* Geometry)
+{
+	if (!Geometry || ItemIndices.Contains(Geometry))
+		return;
+
+	const FTransform Transform = Geometry->GetActorTransform();
+
+	FGeometryReplicatedItem& Item = Items.AddDefaulted_GetRef();
+	Item.GeometryClass = Geometry->GetClass();
+	Item.Location = Transform.GetLocation();
+	Item.Rotation = Transform.Rotator();
+	Item.Scale = Transform.GetScale3D();
+	Item.Data.Pack(Geometry->GetGeometryData());
+	Item.Actor = Geometry;
+	Item.ActorKey = Geometry;
+
+	ItemIndices.Add(Item.ActorKey, Items.Num() - 1);
+	MarkItemDirty(Item);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void FGeometryReplicatedArray::SetColor(ABaseGeometryActor* Geometry, const FLinearColor& Color)
+{
+	SetColor(Geometry, Color.QuantizeRound());
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void FGeometryReplicatedArray::SetColor(ABaseGeometryActor* Geometry, const FColor& PackedColor)
+{
+	const int32* Index = ItemIndices.Find(Geometry);
+	if (!Index)
+		return;
+
+	FGeometryReplicatedItem& Item = Items[*Index];
+	if (Item.Data.Color == PackedColor)
+		return;
+
+	Item.Data.Color = PackedColor;
+	MarkItemDirty(Item);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void FGeometryReplicatedArray::Remove(ABaseGeometryActor* Geometry)
+{
+	int32 Index = INDEX_NONE;
+	if (!ItemIndices.RemoveAndCopyValue(Geometry, Index))
+		return;
+
+	// The order of the items doesn't matter to the clients, the last item takes the free slot
+	Items.RemoveAtSwap(Index, 1, false);
+	if (Index < Items.Num())
+	{
+		ItemIndices.Add(Items[Index].ActorKey, Index);
+	}
+	MarkArrayDirty();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+uint64 FGeometryReplicatedArray::ConsumeNumSerializedBits()
+{
+	const uint64 NumBits = NumSerializedBits;
+	NumSerializedBits = 0;
+	return NumBits;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+bool FGeometryReplicatedArray::NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms)
+{
+	const int64 WriterStart = DeltaParms.Writer ? DeltaParms.Writer->GetNumBits() : 0;
+	const int64 ReaderStart = DeltaParms.Reader ? DeltaParms.Reader->GetPosBits() : 0;
+
+	const bool bResult = FastArrayDeltaSerialize<FGeometryReplicatedItem, FGeometryReplicatedArray>(Items, DeltaParms, *this);
+
+	// Once per connection on the server, so this is the real outgoing bandwidth of the hub
+	if (DeltaParms.Writer)
+	{
+		NumSerializedBits += DeltaParms.Writer->GetNumBits() - WriterStart;
+	}
+	if (DeltaParms.Reader)
+	{
+		NumSerializedBits += DeltaParms.Reader->GetPosBits() - ReaderStart;
+	}
+	return bResult;
+}
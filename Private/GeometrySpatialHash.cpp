@@ -0,0 +1,246 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GeometrySpatialHash.h"
+#include "BaseGeometryActor.h"
+#include "GeometryFrameArena.h"
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+FGeometrySpatialHash::FGeometrySpatialHash(float InCellSize)
+	: CellSize(FMath::Max(InCellSize, 1.0f))
+{
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void FGeometrySpatialHash::SetCellSize(float InCellSize)
+{
+	CellSize = FMath::Max(InCellSize, 1.0f);
+
+	Cells.Reset();
+	for (int32 EntryIndex = 0; EntryIndex < Entries.Num(); ++EntryIndex)
+	{
+		Entries[EntryIndex].Cell = ToCell(Entries[EntryIndex].Location);
+		AddToCell(EntryIndex);
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void FGeometrySpatialHash::Add(ABaseGeometryActor* Actor, bool bMoving)
+{
+	if (!Actor)
+		return;
+
+	if (const int32* ExistingIndex = EntryByActor.Find(Actor))
+	{
+		// A stale entry of a destroyed actor whose memory the new one reuses
+		if (Entries[*ExistingIndex].Actor.IsValid())
+			return;
+
+		RemoveEntry(*ExistingIndex);
+	}
+
+	FEntry& Entry = Entries.AddDefaulted_GetRef();
+	Entry.Actor = Actor;
+	Entry.ActorKey = Actor;
+	Entry.Location = Actor->GetActorLocation();
+	Entry.Cell = ToCell(Entry.Location);
+	Entry.bMoving = bMoving;
+
+	const int32 EntryIndex = Entries.Num() - 1;
+	EntryByActor.Add(Actor, EntryIndex);
+	AddToCell(EntryIndex);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void FGeometrySpatialHash::Remove(const ABaseGeometryActor* Actor)
+{
+	if (const int32* EntryIndex = EntryByActor.Find(Actor))
+	{
+		RemoveEntry(*EntryIndex);
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void FGeometrySpatialHash::Reset()
+{
+	Entries.Reset();
+	EntryByActor.Reset();
+	Cells.Reset();
+	StaleActorKeys.Reset();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void FGeometrySpatialHash::RefreshMovingEntries()
+{
+	// A key may have been noted by several queries or reused by a new actor since, only entries still invalid are dropped
+	for (const ABaseGeometryActor* ActorKey : StaleActorKeys)
+	{
+		const int32* EntryIndex = EntryByActor.Find(ActorKey);
+		if (EntryIndex && !Entries[*EntryIndex].Actor.IsValid())
+		{
+			RemoveEntry(*EntryIndex);
+		}
+	}
+	StaleActorKeys.Reset();
+
+	// Backwards, so an entry swapped in by RemoveEntry has already been refreshed
+	for (int32 EntryIndex = Entries.Num() - 1; EntryIndex >= 0; --EntryIndex)
+	{
+		FEntry& Entry = Entries[EntryIndex];
+		if (!Entry.bMoving)
+			continue;
+
+		const ABaseGeometryActor* Actor = Entry.Actor.Get();
+		if (!Actor)
+		{
+			RemoveEntry(EntryIndex);
+			continue;
+		}
+
+		Entry.Location = Actor->GetActorLocation();
+
+		const FIntVector NewCell = ToCell(Entry.Location);
+		if (NewCell != Entry.Cell)
+		{
+			RemoveFromCell(EntryIndex);
+			Entries[EntryIndex].Cell = NewCell;
+			AddToCell(EntryIndex);
+		}
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+template <typename AllocatorType>
+void FGeometrySpatialHash::QuerySphere(const FVector& Center, float Radius, TArray<ABaseGeometryActor*, AllocatorType>& OutActors) const
+{
+	const float RadiusSquared = FMath::Square(Radius);
+	QueryCells(FBox(Center - FVector(Radius), Center + FVector(Radius)), [&Center, RadiusSquared](const FVector& Location)
+	{
+		return FVector::DistSquared(Center, Location) <= RadiusSquared;
+	}, OutActors);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+template <typename AllocatorType>
+void FGeometrySpatialHash::QueryBox(const FBox& Box, TArray<ABaseGeometryActor*, AllocatorType>& OutActors) const
+{
+	QueryCells(Box, [&Box](const FVector& Location)
+	{
+		return Box.IsInsideOrOn(Location);
+	}, OutActors);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+template <typename PredicateType, typename AllocatorType>
+void FGeometrySpatialHash::QueryCells(const FBox& Bounds, PredicateType Predicate, TArray<ABaseGeometryActor*, AllocatorType>& OutActors) const
+{
+	if (!Bounds.IsValid || Entries.Num() == 0)
+		return;
+
+	const FIntVector MinCell = ToCell(Bounds.Min);
+	const FIntVector MaxCell = ToCell(Bounds.Max);
+
+	// A huge query would visit more cells than the grid has, walk the cells of the grid then
+	const int64 NumQueryCells = int64(MaxCell.X - MinCell.X + 1) * (MaxCell.Y - MinCell.Y + 1) * (MaxCell.Z - MinCell.Z + 1);
+	const auto VisitCell = [this, &Predicate, &OutActors](const TArray<int32>& CellEntries)
+	{
+		for (const int32 EntryIndex : CellEntries)
+		{
+			const FEntry& Entry = Entries[EntryIndex];
+			if (!Predicate(Entry.Location))
+				continue;
+
+			if (ABaseGeometryActor* Actor = Entry.Actor.Get())
+			{
+				OutActors.Add(Actor);
+			}
+			else if (!Entry.bMoving)
+			{
+				StaleActorKeys.Add(Entry.ActorKey);
+			}
+		}
+	};
+
+	if (NumQueryCells > Cells.Num())
+	{
+		for (const TPair<FIntVector, TArray<int32>>& Pair : Cells)
+		{
+			const FIntVector& Cell = Pair.Key;
+			if (Cell.X >= MinCell.X && Cell.X <= MaxCell.X && Cell.Y >= MinCell.Y && Cell.Y <= MaxCell.Y && Cell.Z >= MinCell.Z && Cell.Z <= MaxCell.Z)
+			{
+				VisitCell(Pair.Value);
+			}
+		}
+		return;
+	}
+
+	for (int32 Z = MinCell.Z; Z <= MaxCell.Z; ++Z)
+	{
+		for (int32 Y = MinCell.Y; Y <= MaxCell.Y; ++Y)
+		{
+			for (int32 X = MinCell.X; X <= MaxCell.X; ++X)
+			{
+				if (const TArray<int32>* CellEntries = Cells.Find(FIntVector(X, Y, Z)))
+				{
+					VisitCell(*CellEntries);
+				}
+			}
+		}
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+FIntVector FGeometrySpatialHash::ToCell(const FVector& Location) const
+{
+	return FIntVector(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize), FMath::FloorToInt(Location.Z / CellSize));
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void FGeometrySpatialHash::AddToCell(int32 EntryIndex)
+{
+	FEntry& Entry = Entries[EntryIndex];
+	Entry.IndexInCell = Cells.FindOrAdd(Entry.Cell).Add(EntryIndex);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void FGeometrySpatialHash::RemoveFromCell(int32 EntryIndex)
+{
+	FEntry& Entry = Entries[EntryIndex];
+	TArray<int32>* CellEntries = Cells.Find(Entry.Cell);
+	if (!CellEntries)
+		return;
+
+	CellEntries->RemoveAtSwap(Entry.IndexInCell, 1, false);
+	if (CellEntries->IsValidIndex(Entry.IndexInCell))
+	{
+		Entries[(*CellEntries)[Entry.IndexInCell]].IndexInCell = Entry.IndexInCell;
+	}
+
+	Entry.IndexInCell = INDEX_NONE;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void FGeometrySpatialHash::RemoveEntry(int32 EntryIndex)
+{
+	RemoveFromCell(EntryIndex);
+	EntryByActor.Remove(Entries[EntryIndex].ActorKey);
+
+	const int32 LastIndex = Entries.Num() - 1;
+	if (EntryIndex != LastIndex)
+	{
+		// The last entry moves into the freed slot, its cell and the actor map must point to the new index
+		Entries[EntryIndex] = Entries[LastIndex];
+		const FEntry& Moved = Entries[EntryIndex];
+		Cells.FindChecked(Moved.Cell)[Moved.IndexInCell] = EntryIndex;
+		EntryByActor.Add(Moved.ActorKey, EntryIndex);
+	}
+
+	Entries.RemoveAt(LastIndex, 1, false);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+// Heap results for the gameplay queries, frame arena results for the per-frame code
+template void FGeometrySpatialHash::QuerySphere(const FVector&, float, TArray<ABaseGeometryActor*>&) const;
+template void FGeometrySpatialHash::QuerySphere(const FVector&, float, TGeometryFrameArray<ABaseGeometryActor*>&) const;
+template void FGeometrySpatialHash::QueryBox(const FBox&, TArray<ABaseGeometryActor*>&) const;
+template void FGeometrySpatialHash::QueryBox(const FBox&, TGeometryFrameArray<ABaseGeometryActor*>&) const;
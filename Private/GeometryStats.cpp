@@ -0,0 +1,85 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GeometryStats.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+#include "UObject/UObjectGlobals.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogGeometryGC, All, All)
+
+DEFINE_STAT(STAT_GeometryDelegateBroadcasts);
+DEFINE_STAT(STAT_GeometryQueuedEvents);
+DEFINE_STAT(STAT_GeometryMIDAllocations);
+DEFINE_STAT(STAT_GeometryLiveSinActors);
+DEFINE_STAT(STAT_GeometryLiveStaticActors);
+DEFINE_STAT(STAT_GeometryLiveOrbitActors);
+DEFINE_STAT(STAT_GeometryLiveBounceActors);
+DEFINE_STAT(STAT_GeometryLiveLissajousActors);
+DEFINE_STAT(STAT_GeometryLiveCustom1Actors);
+DEFINE_STAT(STAT_GeometryLiveCustom2Actors);
+DEFINE_STAT(STAT_GeometryLiveCustom3Actors);
+DEFINE_STAT(STAT_GeometryMIDAllocationsTotal);
+DEFINE_STAT(STAT_GeometryLastGCPauseMs);
+
+static GeometryGC::FPauseStats GCPauseStats;
+static double GCStartTime = 0.0;
+static bool bGCTracking = false;
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void GeometryGC::StartTracking()
+{
+	if (bGCTracking)
+		return;
+
+	bGCTracking = true;
+	FCoreUObjectDelegates::GetPreGarbageCollectDelegate().AddLambda([]()
+	{
+		GCStartTime = FPlatformTime::Seconds();
+	});
+	FCoreUObjectDelegates::GetPostGarbageCollect().AddLambda([]()
+	{
+		if (GCStartTime <= 0.0)
+			return;
+
+		const double PauseMs = (FPlatformTime::Seconds() - GCStartTime) * 1000.0;
+		GCStartTime = 0.0;
+
+		++GCPauseStats.NumCollections;
+		GCPauseStats.TotalMs += PauseMs;
+		GCPauseStats.MaxMs = FMath::Max(GCPauseStats.MaxMs, PauseMs);
+		GCPauseStats.LastMs = PauseMs;
+		SET_FLOAT_STAT(STAT_GeometryLastGCPauseMs, PauseMs);
+	});
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+const GeometryGC::FPauseStats& GeometryGC::GetPauseStats()
+{
+	return GCPauseStats;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void GeometryGC::ResetPauseStats()
+{
+	GCPauseStats = FPauseStats();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+// Usage: geometry.GC.Report [-reset]
+static FAutoConsoleCommand GGeometryGCReportCommand(
+	TEXT("geometry.GC.Report"),
+	TEXT("Logs the garbage collection pauses since the tracking started or the last -reset, then optionally resets them."),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		GeometryGC::StartTracking();
+
+		const GeometryGC::FPauseStats& Stats = GeometryGC::GetPauseStats();
+		UE_LOG(LogGeometryGC, Display, TEXT("%d collections: average %.2f ms, max %.2f ms, last %.2f ms"), Stats.NumCollections,
+		       Stats.NumCollections > 0 ? Stats.TotalMs / Stats.NumCollections : 0.0, Stats.MaxMs, Stats.LastMs);
+
+		if (Args.Contains(TEXT("-reset")))
+		{
+			GeometryGC::ResetPauseStats();
+		}
+	}));
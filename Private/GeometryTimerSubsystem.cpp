@@ -0,0 +1,129 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GeometryTimerSubsystem.h"
+#include "BaseGeometryActor.h"
+#include "Engine/World.h"
+#include "GeometryStats.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+
+DECLARE_CYCLE_STAT(TEXT("Timer Buckets"), STAT_GeometryTimerBuckets, STATGROUP_GeometryActors);
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryTimerSubsystem::Deinitialize()
+{
+	for (FBucket& Bucket : Buckets)
+	{
+		for (ABaseGeometryActor* Actor : Bucket.Actors)
+		{
+			Actor->TimerBucket = INDEX_NONE;
+			Actor->TimerSlot = INDEX_NONE;
+		}
+	}
+
+	Buckets.Reset();
+	BucketByRate.Reset();
+	NumTimers = 0;
+
+	Super::Deinitialize();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+TStatId UGeometryTimerSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UGeometryTimerSubsystem, STATGROUP_Tickables);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryTimerSubsystem::AddTimer(ABaseGeometryActor* Actor, float TimeRate)
+{
+	if (!Actor || Actor->TimerBucket != INDEX_NONE)
+		return;
+
+	const int32 RateTicks = FMath::Max(FMath::RoundToInt(TimeRate / Resolution), 1);
+
+	int32 BucketIndex;
+	if (const int32* Found = BucketByRate.Find(RateTicks))
+	{
+		BucketIndex = *Found;
+	}
+	else
+	{
+		BucketIndex = Buckets.AddDefaulted();
+		FBucket& NewBucket = Buckets[BucketIndex];
+		NewBucket.RateTicks = RateTicks;
+		NewBucket.Period = RateTicks * Resolution;
+		NewBucket.NextFireTime = GetWorld()->GetTimeSeconds() + NewBucket.Period;
+		BucketByRate.Add(RateTicks, BucketIndex);
+	}
+
+	Actor->TimerBucket = BucketIndex;
+	Actor->TimerSlot = Buckets[BucketIndex].Actors.Add(Actor);
+	++NumTimers;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryTimerSubsystem::CancelTimer(ABaseGeometryActor* Actor)
+{
+	if (!Actor || !Buckets.IsValidIndex(Actor->TimerBucket))
+		return;
+
+	TArray<ABaseGeometryActor*>& Actors = Buckets[Actor->TimerBucket].Actors;
+	const int32 Slot = Actor->TimerSlot;
+	if (!Actors.IsValidIndex(Slot) || Actors[Slot] != Actor)
+		return;
+
+	Actors.RemoveAtSwap(Slot, 1, false);
+
+	// The last actor of the bucket has been moved into the freed slot
+	if (Actors.IsValidIndex(Slot))
+	{
+		Actors[Slot]->TimerSlot = Slot;
+	}
+
+	Actor->TimerBucket = INDEX_NONE;
+	Actor->TimerSlot = INDEX_NONE;
+	--NumTimers;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryTimerSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	const double Time = GetWorld()->GetTimeSeconds();
+
+	// Buckets may be added from OnTimerFired, so they are addressed by index and not by reference
+	for (int32 BucketIndex = 0; BucketIndex < Buckets.Num(); ++BucketIndex)
+	{
+		// Like a looping FTimerHandle, a long frame fires the missed periods one after another
+		while (Buckets[BucketIndex].NextFireTime <= Time)
+		{
+			Buckets[BucketIndex].NextFireTime += Buckets[BucketIndex].Period;
+			FireBucket(BucketIndex);
+		}
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+void UGeometryTimerSubsystem::FireBucket(int32 BucketIndex)
+{
+	SCOPE_CYCLE_COUNTER(STAT_GeometryTimerBuckets);
+	TRACE_CPUPROFILER_EVENT_SCOPE(UGeometryTimerSubsystem::FireBucket);
+
+	// OnTimerFired may cancel any timer, which swaps actors around in the bucket. The batch fires a copy of the bucket taken
+	// before the first call: an actor cancelled by an earlier callback is skipped, one added during the batch waits for
+	// the next period, and no actor fires twice.
+	FiringActors.Reset();
+	FiringActors.Append(Buckets[BucketIndex].Actors);
+
+	for (ABaseGeometryActor* Actor : FiringActors)
+	{
+		// Destroyed actors are only collected after the frame, a cancelled one still answers this
+		if (Actor->TimerBucket != BucketIndex)
+			continue;
+
+		Actor->OnTimerFired();
+	}
+	FiringActors.Reset();
+}
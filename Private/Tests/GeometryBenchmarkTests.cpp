@@ -0,0 +1,111 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GeometryBenchmarkSubsystem.h"
+#include "GeometryTestWorld.h"
+#include "EngineUtils.h"
+#include "Misc/AutomationTest.h"
+#include "UObject/UObjectGlobals.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FGeometryBenchmarkCasesTest, "Project.Geometry.Benchmark.Cases",
+                                 EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FGeometryBenchmarkCasesTest::RunTest(const FString& Parameters)
+{
+	FGeometryTestWorld TestWorld;
+	UGeometryBenchmarkSubsystem* Benchmark = TestWorld.Get()->GetSubsystem<UGeometryBenchmarkSubsystem>();
+	if (!TestNotNull(TEXT("Benchmark subsystem"), Benchmark))
+		return false;
+
+	constexpr int32 NumFrames = 5;
+	Benchmark->StartBenchmark({10, 20}, NumFrames, false, false);
+
+	// Warm-up and recorded frames of the four cases, with a margin
+	for (int32 Frame = 0; Frame < 100 && Benchmark->IsRunning(); ++Frame)
+	{
+		Benchmark->Tick(1.0f / 60.0f);
+	}
+	TestFalse(TEXT("Benchmark finished"), Benchmark->IsRunning());
+
+	const TArray<UGeometryBenchmarkSubsystem::FCase>& Cases = Benchmark->GetCases();
+	const TArray<EMovementType> MoveTypes = UGeometryBenchmarkSubsystem::GetBenchmarkedMoveTypes();
+	TestTrue(TEXT("The built-in models are benchmarked"), MoveTypes.Contains(EMovementType::Sin) && MoveTypes.Contains(EMovementType::Orbit) &&
+	         MoveTypes.Contains(EMovementType::Bounce) && MoveTypes.Contains(EMovementType::Lissajous));
+	if (!TestEqual(TEXT("One case per count and move type"), Cases.Num(), 2 * MoveTypes.Num()))
+		return false;
+
+	const double MinBytesPerActor = ABaseGeometryActor::StaticClass()->GetStructureSize();
+	for (const UGeometryBenchmarkSubsystem::FCase& Case : Cases)
+	{
+		// Five frames: the p99 is the slowest one
+		TestTrue(TEXT("P99 frame time at least the average"), Case.P99FrameMs >= Case.AverageFrameMs);
+		TestTrue(TEXT("Actor memory counts at least the actor object"), Case.BytesPerActor >= MinBytesPerActor);
+	}
+
+	int32 NumRemaining = 0;
+	for (TActorIterator<ABaseGeometryActor> It(TestWorld.Get()); It; ++It)
+	{
+		++NumRemaining;
+	}
+	TestEqual(TEXT("Actors destroyed after their case"), NumRemaining, 0);
+
+	return true;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FGeometryBenchmarkExternalDestroyTest, "Project.Geometry.Benchmark.ExternalDestroy",
+                                 EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FGeometryBenchmarkExternalDestroyTest::RunTest(const FString& Parameters)
+{
+	FGeometryTestWorld TestWorld;
+	UGeometryBenchmarkSubsystem* Benchmark = TestWorld.Get()->GetSubsystem<UGeometryBenchmarkSubsystem>();
+	if (!TestNotNull(TEXT("Benchmark subsystem"), Benchmark))
+		return false;
+
+	Benchmark->StartBenchmark({10}, 1, false, false);
+
+	// Destroyed and collected in the middle of the case, the benchmark must skip it when the case ends
+	for (TActorIterator<ABaseGeometryActor> It(TestWorld.Get()); It; ++It)
+	{
+		It->Destroy();
+	}
+	CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+
+	for (int32 Frame = 0; Frame < 100 && Benchmark->IsRunning(); ++Frame)
+	{
+		Benchmark->Tick(1.0f / 60.0f);
+	}
+	TestFalse(TEXT("Benchmark finished"), Benchmark->IsRunning());
+
+	return true;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FGeometryBenchmarkActorMemoryTest, "Project.Geometry.Benchmark.ActorMemory",
+                                 EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FGeometryBenchmarkActorMemoryTest::RunTest(const FString& Parameters)
+{
+	FGeometryTestWorld TestWorld;
+	const ABaseGeometryActor* Geometry = TestWorld.Get()->SpawnActor<ABaseGeometryActor>(ABaseGeometryActor::StaticClass(), FTransform::Identity);
+	if (!TestNotNull(TEXT("Spawned actor"), Geometry))
+		return false;
+
+	// The actor and its mesh component at least
+	SIZE_T MinBytes = Geometry->GetClass()->GetStructureSize();
+	for (const UActorComponent* Component : Geometry->GetComponents())
+	{
+		MinBytes += Component->GetClass()->GetStructureSize();
+	}
+
+	TestTrue(TEXT("Actor memory covers the actor and its components"), UGeometryBenchmarkSubsystem::GetActorMemoryBytes(Geometry) >= MinBytes);
+	TestEqual(TEXT("No actor, no memory"), UGeometryBenchmarkSubsystem::GetActorMemoryBytes(nullptr), static_cast<SIZE_T>(0));
+
+	return true;
+}
+
+#endif
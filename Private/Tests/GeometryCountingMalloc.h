@@ -0,0 +1,101 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "HAL/MemoryBase.h"
+
+// Forwards everything to the allocator it replaces and counts the allocations of the game thread
+class FGeometryCountingMalloc final : public FMalloc
+{
+public:
+	FMalloc* Inner = nullptr;
+	int32 NumAllocations = 0;
+
+	virtual void* Malloc(SIZE_T Size, uint32 Alignment) override
+	{
+		CountAllocation();
+		return Inner->Malloc(Size, Alignment);
+	}
+
+	virtual void* Realloc(void* Original, SIZE_T Size, uint32 Alignment) override
+	{
+		if (Size > 0)
+		{
+			CountAllocation();
+		}
+		return Inner->Realloc(Original, Size, Alignment);
+	}
+
+	virtual void Free(void* Original) override
+	{
+		Inner->Free(Original);
+	}
+
+	virtual SIZE_T QuantizeSize(SIZE_T Size, uint32 Alignment) override
+	{
+		return Inner->QuantizeSize(Size, Alignment);
+	}
+
+	virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override
+	{
+		return Inner->GetAllocationSize(Original, SizeOut);
+	}
+
+	virtual void Trim(bool bTrimThreadCaches) override
+	{
+		Inner->Trim(bTrimThreadCaches);
+	}
+
+	virtual void SetupTLSCachesOnCurrentThread() override
+	{
+		Inner->SetupTLSCachesOnCurrentThread();
+	}
+
+	virtual void ClearAndDisableTLSCachesOnCurrentThread() override
+	{
+		Inner->ClearAndDisableTLSCachesOnCurrentThread();
+	}
+
+	virtual bool IsInternallyThreadSafe() const override
+	{
+		return Inner->IsInternallyThreadSafe();
+	}
+
+	virtual const TCHAR* GetDescriptiveName() override
+	{
+		return Inner->GetDescriptiveName();
+	}
+
+private:
+	void CountAllocation()
+	{
+		// The other threads keep allocating while the game thread is measured
+		if (IsInGameThread())
+		{
+			++NumAllocations;
+		}
+	}
+};
+
+// Heap allocations (Malloc and Realloc) made on the game thread while Function runs
+inline int32 CountHeapAllocations(TFunctionRef<void()> Function)
+{
+	check(IsInGameThread());
+
+	// Static, a thread which read GMalloc just before it is restored may still call it afterwards
+	static FGeometryCountingMalloc CountingMalloc;
+	CountingMalloc.Inner = GMalloc;
+	CountingMalloc.NumAllocations = 0;
+
+	GMalloc = &CountingMalloc;
+	Function();
+	GMalloc = CountingMalloc.Inner;
+
+	return CountingMalloc.NumAllocations;
+}
+
+#endif
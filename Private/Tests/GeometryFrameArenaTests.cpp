@@ -0,0 +1,125 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GeometryCountingMalloc.h"
+#include "GeometryEventSubsystem.h"
+#include "GeometryFrameArena.h"
+#include "GeometryHubActor.h"
+#include "GeometryMovementSubsystem.h"
+#include "GeometryTestWorld.h"
+#include "GeometryTimerSubsystem.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FGeometryFrameArenaSteadyTickTest, "Project.Geometry.FrameArena.SteadyStateTick",
+                                 EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FGeometryFrameArenaSteadyTickTest::RunTest(const FString& Parameters)
+{
+	constexpr int32 NumPayloads = 500;
+	constexpr int32 NumWarmUpFrames = 30;
+	constexpr int32 NumFrames = 60;
+	const float Radius = 1000.0f;
+	const float DeltaTime = 1.0f / 60.0f;
+
+	FGeometryTestWorld TestWorld;
+	UWorld* World = TestWorld.Get();
+
+	// Half of the shapes move with the movement subsystem, so the refresh of the spatial index has work to do
+	TArray<FGeometryPayload> Payloads;
+	for (int32 i = 0; i < NumPayloads; ++i)
+	{
+		FGeometryPayload& Payload = Payloads.AddDefaulted_GetRef();
+		Payload.GeometryClass = ABaseGeometryActor::StaticClass();
+		Payload.InitialTransform.SetLocation(FVector(300.0f * (i % 25), 300.0f * (i / 25), 330.0f));
+		Payload.Data.MoveType = i % 2 ? EMovementType::Sin : EMovementType::Static;
+		// Longer than the test, no timer finishes while the allocations are counted
+		Payload.Data.TimeRate = 1000.0f;
+	}
+
+	AGeometryHubActor* Hub = World->SpawnActorDeferred<AGeometryHubActor>(AGeometryHubActor::StaticClass(), FTransform::Identity);
+	if (!TestNotNull(TEXT("Spawned hub"), Hub))
+		return false;
+
+	SetGeometryTestProperty<TSubclassOf<ABaseGeometryActor>>(Hub, TEXT("GeometryClass"), ABaseGeometryActor::StaticClass());
+	SetGeometryTestProperty(Hub, TEXT("GeometryPayloads"), Payloads);
+	Hub->FinishSpawning(FTransform::Identity);
+
+	// What per-frame code does with the hub: queries around the shapes into frame arena arrays
+	int32 NumResults = 0;
+	const auto RunQueries = [Hub, &Payloads, Radius, &NumResults]()
+	{
+		for (int32 i = 0; i < Payloads.Num(); i += 10)
+		{
+			const FVector Center = Payloads[i].InitialTransform.GetLocation();
+			TGeometryFrameArray<ABaseGeometryActor*> Result;
+			Hub->CollectGeometryInSphere(Center, Radius, Result);
+			Hub->CollectGeometryInBox(FBox(Center - FVector(Radius), Center + FVector(Radius)), Result);
+			NumResults += Result.Num();
+		}
+	};
+
+	// The test world doesn't run the engine loop, the arena is reset by hand where FCoreDelegates::OnBeginFrame would do it
+	FGeometryFrameArena& Arena = FGeometryFrameArena::Get();
+	const auto RunFrame = [&TestWorld, &Arena, &RunQueries, DeltaTime]()
+	{
+		Arena.Reset();
+		TestWorld.Tick(DeltaTime);
+		RunQueries();
+	};
+
+	// Grows the arena, the cell arrays of the spatial index and the engine's own buffers to their steady state
+	for (int32 Frame = 0; Frame < NumWarmUpFrames; ++Frame)
+	{
+		RunFrame();
+	}
+
+	const int32 NumBlocksBefore = Arena.GetNumBlockAllocations();
+	NumResults = 0;
+
+	UGeometryMovementSubsystem* MovementSubsystem = World->GetSubsystem<UGeometryMovementSubsystem>();
+	UGeometryTimerSubsystem* TimerSubsystem = World->GetSubsystem<UGeometryTimerSubsystem>();
+	UGeometryEventSubsystem* EventSubsystem = World->GetSubsystem<UGeometryEventSubsystem>();
+	if (!TestNotNull(TEXT("Movement subsystem"), MovementSubsystem) || !TestNotNull(TEXT("Timer subsystem"), TimerSubsystem) ||
+		!TestNotNull(TEXT("Event subsystem"), EventSubsystem))
+		return false;
+
+	// The geometry part of a frame must not touch the heap any more: the hub, the subsystems moving the shapes and
+	// firing their timers and events, and the queries. The clock advances as in a world tick, so the shapes really move.
+	const int32 NumGeometryAllocations = CountHeapAllocations(
+		[World, Hub, MovementSubsystem, TimerSubsystem, EventSubsystem, &Arena, &RunQueries, DeltaTime]()
+		{
+			for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+			{
+				Arena.Reset();
+				World->TimeSeconds += DeltaTime;
+				Hub->Tick(DeltaTime);
+				MovementSubsystem->Tick(DeltaTime);
+				TimerSubsystem->Tick(DeltaTime);
+				EventSubsystem->Tick(DeltaTime);
+				RunQueries();
+			}
+		});
+
+	// The whole world tick allocates in the engine too, reported for comparison
+	const int32 NumWorldAllocations = CountHeapAllocations([&RunFrame]()
+	{
+		for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+		{
+			RunFrame();
+		}
+	});
+
+	TestTrue(TEXT("The queries found the shapes"), NumResults > 0);
+	TestEqual(TEXT("Heap allocations of the geometry ticks and the queries"), NumGeometryAllocations, 0);
+	TestEqual(TEXT("New frame arena blocks"), Arena.GetNumBlockAllocations() - NumBlocksBefore, 0);
+
+	AddInfo(FString::Printf(TEXT("%d frames: geometry ticks and queries %d heap allocations, world tick and queries %d heap allocations, ")
+	                        TEXT("frame arena high water %llu bytes"), NumFrames, NumGeometryAllocations, NumWorldAllocations,
+	                        static_cast<uint64>(Arena.GetHighWaterMark())));
+	return true;
+}
+
+#endif
@@ -0,0 +1,174 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BaseGeometryActor.h"
+#include "GeometryCountingMalloc.h"
+#include "GeometryLogging.h"
+#include "GeometryTestWorld.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/OutputDevice.h"
+#include "UObject/UObjectGlobals.h"
+#include <atomic>
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+// Counts the lines GLog receives for one category while it exists
+class FGeometryLogCapture final : public FOutputDevice
+{
+public:
+	explicit FGeometryLogCapture(const FName InCategory) : Category(InCategory)
+	{
+		GLog->AddOutputDevice(this);
+	}
+
+	virtual ~FGeometryLogCapture() override
+	{
+		GLog->RemoveOutputDevice(this);
+	}
+
+	virtual void Serialize(const TCHAR* Message, ELogVerbosity::Type Verbosity, const FName& InCategory) override
+	{
+		if (InCategory == Category)
+		{
+			NumLines.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	virtual bool CanBeUsedOnAnyThread() const override { return true; }
+	virtual bool CanBeUsedOnMultipleThreads() const override { return true; }
+
+	int32 GetNumLines() const { return NumLines.load(std::memory_order_relaxed); }
+
+private:
+	FName Category;
+	std::atomic<int32> NumLines{0};
+};
+
+// Spawns NumActors geometry actors, returns the milliseconds their spawn and BeginPlay took
+static double MeasureGeometryStartup(UWorld* World, int32 NumActors)
+{
+	TArray<ABaseGeometryActor*> Actors;
+	Actors.Reserve(NumActors);
+
+	const double StartTime = FPlatformTime::Seconds();
+	for (int32 i = 0; i < NumActors; ++i)
+	{
+		const FTransform Transform(FVector(300.0f * (i % 100), 300.0f * (i / 100), 330.0f));
+		Actors.Add(World->SpawnActor<ABaseGeometryActor>(ABaseGeometryActor::StaticClass(), Transform));
+	}
+	const double StartupMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+	for (ABaseGeometryActor* Geometry : Actors)
+	{
+		if (Geometry)
+		{
+			Geometry->Destroy();
+		}
+	}
+	// Every case starts with the same world
+	CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS, true);
+	return StartupMs;
+}
+
+static double GetMedian(TArray<double> Values)
+{
+	Values.Sort();
+	return Values.Num() > 0 ? Values[Values.Num() / 2] : 0.0;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FGeometryLoggingInactiveTest, "Project.Geometry.Logging.InactiveVerbose",
+                                 EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FGeometryLoggingInactiveTest::RunTest(const FString& Parameters)
+{
+	constexpr int32 NumCalls = 100;
+
+	FGeometryTestWorld TestWorld;
+	ABaseGeometryActor* Geometry = TestWorld.Get()->SpawnActor<ABaseGeometryActor>(ABaseGeometryActor::StaticClass(), FTransform::Identity);
+	if (!TestNotNull(TEXT("Spawned actor"), Geometry))
+		return false;
+
+	const ELogVerbosity::Type PreviousVerbosity = LogBaseGeometry.GetVerbosity();
+	FGeometryLogCapture Capture(LogBaseGeometry.GetCategoryName());
+
+	// The default verbosity: no line, and no string built for one
+	LogBaseGeometry.SetVerbosity(ELogVerbosity::Log);
+	const int32 NumAllocations = CountHeapAllocations([Geometry]()
+	{
+		for (int32 i = 0; i < NumCalls; ++i)
+		{
+			Geometry->PrintTransform();
+		}
+	});
+	GLog->Flush();
+	TestEqual(TEXT("Heap allocations of PrintTransform with Verbose inactive"), NumAllocations, 0);
+	TestEqual(TEXT("Lines of PrintTransform with Verbose inactive"), Capture.GetNumLines(), 0);
+
+#if GEOMETRY_DIAGNOSTIC_LOGGING
+	// The capture does see the lines once they are switched on
+	LogBaseGeometry.SetVerbosity(ELogVerbosity::Verbose);
+	Geometry->PrintTransform();
+	GLog->Flush();
+	TestTrue(TEXT("Lines of PrintTransform with Verbose active"), Capture.GetNumLines() > 0);
+#endif
+
+	LogBaseGeometry.SetVerbosity(PreviousVerbosity);
+	return true;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+// Before: the diagnostic lines logged as they were before they became Verbose. After: the default verbosity.
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FGeometryLoggingStartupTest, "Project.Geometry.Logging.StartupCost",
+                                 EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FGeometryLoggingStartupTest::RunTest(const FString& Parameters)
+{
+	constexpr int32 NumActors = 1000;
+	constexpr int32 NumRounds = 5;
+
+	FGeometryTestWorld TestWorld;
+	const ELogVerbosity::Type PreviousVerbosity = LogBaseGeometry.GetVerbosity();
+
+	// The first spawns load the mesh and the material, they would count against whichever case runs first
+	MeasureGeometryStartup(TestWorld.Get(), 100);
+
+	// The cases alternate which one goes first, so neither always runs in the warmer world
+	TArray<double> OffMs;
+	TArray<double> OnMs;
+	for (int32 Round = 0; Round < NumRounds; ++Round)
+	{
+		const bool bOnFirst = Round % 2 == 1;
+		for (int32 Case = 0; Case < 2; ++Case)
+		{
+			const bool bOn = (Case == 0) == bOnFirst;
+#if !GEOMETRY_DIAGNOSTIC_LOGGING
+			if (bOn)
+				continue;
+#endif
+			LogBaseGeometry.SetVerbosity(bOn ? ELogVerbosity::Verbose : ELogVerbosity::Log);
+			(bOn ? OnMs : OffMs).Add(MeasureGeometryStartup(TestWorld.Get(), NumActors));
+		}
+	}
+
+	LogBaseGeometry.SetVerbosity(PreviousVerbosity);
+	TestEqual(TEXT("Verbosity restored"), static_cast<int32>(LogBaseGeometry.GetVerbosity()), static_cast<int32>(PreviousVerbosity));
+	TestEqual(TEXT("Measured rounds"), OffMs.Num(), NumRounds);
+
+	const double MedianOffMs = GetMedian(OffMs);
+	AddInfo(FString::Printf(TEXT("Diagnostic logging off: %d actors started in %.2f ms (%.2f us/actor), median of %d"), NumActors, MedianOffMs,
+	                        MedianOffMs * 1000.0 / NumActors, OffMs.Num()));
+
+#if GEOMETRY_DIAGNOSTIC_LOGGING
+	const double MedianOnMs = GetMedian(OnMs);
+	AddInfo(FString::Printf(TEXT("Diagnostic logging on: %d actors started in %.2f ms (%.2f us/actor), median of %d"), NumActors, MedianOnMs,
+	                        MedianOnMs * 1000.0 / NumActors, OnMs.Num()));
+#else
+	AddInfo(TEXT("Diagnostic logging is compiled out, there is no logging case to compare with"));
+#endif
+
+	return true;
+}
+
+#endif
@@ -0,0 +1,81 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GeometryPackedData.h"
+#include "GeometryBenchmarkSubsystem.h"
+#include "GeometryLayoutFile.h"
+#include "GeometryTestWorld.h"
+#include "Misc/AutomationTest.h"
+#include "Serialization/BitReader.h"
+#include "Serialization/BitWriter.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FGeometryPackedRoundTripTest, "Project.Geometry.PackedData.RoundTrip",
+                                 EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FGeometryPackedRoundTripTest::RunTest(const FString& Parameters)
+{
+	FString Error;
+	if (!GeometryPacking::ValidateRoundTrip(10000, Error))
+	{
+		AddError(Error);
+		return false;
+	}
+
+	// The network form carries the same bits as the packed struct
+	FGeometryData Data;
+	Data.Amplitude = 123.5f;
+	Data.Frequency = 4.25f;
+	Data.TimeRate = 0.5f;
+	Data.MoveType = EMovementType::Sin;
+	Data.Color = FLinearColor(0.2f, 0.4f, 0.6f, 1.0f);
+	FPackedGeometryData Packed(Data);
+
+	FBitWriter Writer(0, true);
+	bool bSuccess = false;
+	Packed.NetSerialize(Writer, nullptr, bSuccess);
+	TestTrue(TEXT("Writing succeeded"), bSuccess);
+
+	FBitReader Reader(Writer.GetData(), Writer.GetNumBits());
+	FPackedGeometryData Received;
+	Received.NetSerialize(Reader, nullptr, bSuccess);
+	TestTrue(TEXT("Reading succeeded"), bSuccess);
+	TestTrue(TEXT("Replicated data equals the packed data"), Received == Packed);
+	TestEqual(TEXT("Replicated bits"), GeometryPacking::GetNetSerializedBits(Packed),
+	          static_cast<int64>(80 + FPackedGeometryData::MoveTypeBits));
+
+	return true;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FGeometryPackedMemoryTest, "Project.Geometry.PackedData.Memory",
+                                 EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FGeometryPackedMemoryTest::RunTest(const FString& Parameters)
+{
+	FGeometryTestWorld TestWorld;
+	const ABaseGeometryActor* Geometry = TestWorld.Get()->SpawnActor<ABaseGeometryActor>(ABaseGeometryActor::StaticClass(), FTransform::Identity);
+	if (!TestNotNull(TEXT("Spawned actor"), Geometry))
+		return false;
+
+	// Sizes of this build: run it in the editor and in a cooked game to see what the editor-only fields cost
+	const int32 EditorOnlyBytes = GeometryPacking::GetEditorOnlyBytes(ABaseGeometryActor::StaticClass());
+	AddInfo(FString::Printf(TEXT("Geometry data: %d bytes editor-facing, %d bytes packed, %lld bits replicated"),
+	                        static_cast<int32>(sizeof(FGeometryData)), static_cast<int32>(sizeof(FPackedGeometryData)),
+	                        GeometryPacking::GetNetSerializedBits(FPackedGeometryData(FGeometryData()))));
+	AddInfo(FString::Printf(TEXT("Layout record: %d bytes"), static_cast<int32>(sizeof(FGeometryLayoutRecord))));
+	AddInfo(FString::Printf(TEXT("Geometry actor: %llu bytes with its components, %d of them editor-only fields"),
+	                        static_cast<uint64>(UGeometryBenchmarkSubsystem::GetActorMemoryBytes(Geometry)), EditorOnlyBytes));
+
+#if WITH_EDITORONLY_DATA
+	TestTrue(TEXT("The editor keeps the demo fields"), EditorOnlyBytes > 0);
+#else
+	TestEqual(TEXT("Cooked actors don't carry the demo fields"), EditorOnlyBytes, 0);
+#endif
+
+	return true;
+}
+
+#endif
@@ -0,0 +1,55 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GeometryRandom.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FGeometryRandomFillColorsTest, "Project.Geometry.Random.FillRandomColors",
+                                 EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FGeometryRandomFillColorsTest::RunTest(const FString& Parameters)
+{
+	// Two full chunks of 4096 colors and a partial one
+	constexpr uint64 Seed = 1234;
+	constexpr int32 ChunkSize = 4096;
+	constexpr int32 NumColors = 2 * ChunkSize + 100;
+
+	TArray<FLinearColor> Colors;
+	Colors.SetNumUninitialized(NumColors);
+	GeometryRandom::FillRandomColors(Seed, Colors);
+
+	TArray<FLinearColor> SameSeedColors;
+	SameSeedColors.SetNumUninitialized(NumColors);
+	GeometryRandom::FillRandomColors(Seed, SameSeedColors);
+	TestTrue(TEXT("The same seed gives the same colors"), Colors == SameSeedColors);
+
+	// Chunk i is stream i of the seed, whatever worker filled it
+	for (int32 ChunkIndex = 0; ChunkIndex * ChunkSize < NumColors; ++ChunkIndex)
+	{
+		FGeometryRandomStream Stream(Seed, ChunkIndex);
+		const int32 End = FMath::Min((ChunkIndex + 1) * ChunkSize, NumColors);
+		for (int32 i = ChunkIndex * ChunkSize; i < End; ++i)
+		{
+			if (Colors[i] != Stream.NextColor())
+			{
+				AddError(FString::Printf(TEXT("Color %d differs from stream %d of the seed"), i, ChunkIndex));
+				return false;
+			}
+		}
+	}
+
+	TArray<FLinearColor> OtherSeedColors;
+	OtherSeedColors.SetNumUninitialized(NumColors);
+	GeometryRandom::FillRandomColors(Seed + 1, OtherSeedColors);
+	TestFalse(TEXT("Another seed gives other colors"), Colors == OtherSeedColors);
+
+	// Nothing to fill, no chunk runs
+	GeometryRandom::FillRandomColors(Seed, TArrayView<FLinearColor>());
+
+	return true;
+}
+
+#endif
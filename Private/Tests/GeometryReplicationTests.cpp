@@ -0,0 +1,243 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GeometryReplication.h"
+#include "EngineUtils.h"
+#include "GeometryHubActor.h"
+#include "GeometryEventSubsystem.h"
+#include "GeometryTestWorld.h"
+#include "Misc/AutomationTest.h"
+#include "Serialization/BitWriter.h"
+#include "Tests/AutomationCommon.h"
+
+#if WITH_EDITOR
+#include "Settings/LevelEditorPlaySettings.h"
+#include "Tests/AutomationEditorCommon.h"
+#endif
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+// Bits of the replicated properties of Item, without the class (a NetGUID of the package map) and the fast array headers
+static int64 MeasureItemBits(FGeometryReplicatedItem& Item)
+{
+	FBitWriter Writer(0, true);
+	bool bSuccess = false;
+	Item.Location.NetSerialize(Writer, nullptr, bSuccess);
+	Item.Rotation.NetSerialize(Writer, nullptr, bSuccess);
+	Item.Scale.NetSerialize(Writer, nullptr, bSuccess);
+	Item.Data.NetSerialize(Writer, nullptr, bSuccess);
+	return Writer.GetNumBits();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FGeometryReplicationItemBitsTest, "Project.Geometry.Replication.ItemBits",
+                                 EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FGeometryReplicationItemBitsTest::RunTest(const FString& Parameters)
+{
+	// A shape of the demo layout: a row at 330 units, default data
+	FGeometryReplicatedItem Item;
+	Item.Location = FVector(0.0f, 2700.0f, 330.0f);
+	Item.Data.Pack(FGeometryData());
+	const int64 ItemBits = MeasureItemBits(Item);
+
+	// The parts of the item: a zero rotator takes one bit per component, the data its packed size
+	FBitWriter RotationWriter(0, true);
+	bool bSuccess = false;
+	Item.Rotation.NetSerialize(RotationWriter, nullptr, bSuccess);
+	TestEqual(TEXT("Bits of a zero rotation"), RotationWriter.GetNumBits(), static_cast<int64>(3));
+
+	const int64 DataBits = GeometryPacking::GetNetSerializedBits(Item.Data);
+	TestEqual(TEXT("Bits of the data"), DataBits, static_cast<int64>(80 + FPackedGeometryData::MoveTypeBits));
+
+	// Only the color changes, but the fast array sends the changed item whole: exactly the bits of the add
+	FGeometryReplicatedItem ChangedItem = Item;
+	ChangedItem.Data.Color = FLinearColor(0.25f, 0.5f, 1.0f).QuantizeRound();
+	TestEqual(TEXT("Bits of a color change"), MeasureItemBits(ChangedItem), ItemBits);
+
+	// Multiply by the shapes and the color changes per second for the bandwidth, geometry.Replication.LogBandwidth logs the real one.
+	AddInfo(FString::Printf(TEXT("Replicated shape: %lld bits per add or color change, %lld of them for the data"), ItemBits, DataBits));
+	return true;
+}
+
+#if WITH_EDITOR
+
+// The world of the PIE session with this net mode, the listen server or its client
+static UWorld* FindPIEWorld(ENetMode NetMode)
+{
+	for (const FWorldContext& Context : GEngine->GetWorldContexts())
+	{
+		UWorld* World = Context.World();
+		if (Context.WorldType == EWorldType::PIE && World && World->GetNetMode() == NetMode)
+		{
+			return World;
+		}
+	}
+	return nullptr;
+}
+
+// The shapes don't move, the client copy of a shape is found by its location
+static FIntVector GetLocationKey(const FVector& Location)
+{
+	return FIntVector(FMath::RoundToInt(Location.X), FMath::RoundToInt(Location.Y), FMath::RoundToInt(Location.Z));
+}
+
+static TArray<ABaseGeometryActor*> GetGeometryActors(UWorld* World)
+{
+	TArray<ABaseGeometryActor*> Actors;
+	if (World)
+	{
+		for (TActorIterator<ABaseGeometryActor> It(World); It; ++It)
+		{
+			Actors.Add(*It);
+		}
+	}
+	return Actors;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+// A hub with bReplicateGeometry in a listen server session with one client: what the client sees of the server shapes
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FGeometryReplicationClientTest, "Project.Geometry.Replication.ListenServerClient",
+                                 EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+bool FGeometryReplicationClientTest::RunTest(const FString& Parameters)
+{
+	constexpr int32 NumPayloads = 4;
+	const float TimeRate = 1.0f;
+	const float Timeout = 20.0f;
+
+	// Placed in the level, so the server and the client copy of the map have the same hub
+	UWorld* EditorWorld = FAutomationEditorCommonUtils::CreateNewMap();
+	if (!TestNotNull(TEXT("New map"), EditorWorld))
+		return false;
+
+	TArray<FGeometryPayload> Payloads;
+	for (int32 i = 0; i < NumPayloads; ++i)
+	{
+		FGeometryPayload& Payload = Payloads.AddDefaulted_GetRef();
+		Payload.GeometryClass = ABaseGeometryActor::StaticClass();
+		Payload.InitialTransform = FTransform(FRotator(0.0f, 30.0f * i, 0.0f), FVector(500.0f * i, -1500.0f, 1000.0f), FVector(1.0f + 0.25f * i));
+		Payload.Data.MoveType = EMovementType::Static;
+		Payload.Data.TimeRate = TimeRate;
+	}
+
+	AGeometryHubActor* Hub = EditorWorld->SpawnActor<AGeometryHubActor>();
+	if (!TestNotNull(TEXT("Spawned hub"), Hub))
+		return false;
+
+	SetGeometryTestProperty<TSubclassOf<ABaseGeometryActor>>(Hub, TEXT("GeometryClass"), ABaseGeometryActor::StaticClass());
+	SetGeometryTestProperty(Hub, TEXT("GeometryPayloads"), Payloads);
+	SetGeometryTestProperty(Hub, TEXT("bReplicateGeometry"), true);
+
+	// The play settings are the user's, they are restored at the end
+	ULevelEditorPlaySettings* PlaySettings = GetMutableDefault<ULevelEditorPlaySettings>();
+	EPlayNetMode PreviousNetMode = PIE_Standalone;
+	int32 PreviousNumClients = 1;
+	bool bPreviousRunUnderOneProcess = true;
+	PlaySettings->GetPlayNetMode(PreviousNetMode);
+	PlaySettings->GetPlayNumberOfClients(PreviousNumClients);
+	PlaySettings->GetRunUnderOneProcess(bPreviousRunUnderOneProcess);
+	PlaySettings->SetPlayNetMode(PIE_ListenServer);
+	PlaySettings->SetPlayNumberOfClients(2);
+	PlaySettings->SetRunUnderOneProcess(true);
+
+	// Last color the server sent for each shape, packed as it goes over the network
+	const TSharedRef<TMap<FIntVector, FColor>> ServerColors = MakeShared<TMap<FIntVector, FColor>>();
+
+	ADD_LATENT_AUTOMATION_COMMAND(FStartPIECommand(false));
+
+	ADD_LATENT_AUTOMATION_COMMAND(FUntilCommand([]()
+	{
+		return GetGeometryActors(FindPIEWorld(NM_Client)).Num() >= NumPayloads;
+	}, [this]()
+	{
+		AddError(TEXT("The client didn't get the replicated shapes"));
+		return true;
+	}, Timeout));
+
+	ADD_LATENT_AUTOMATION_COMMAND(FFunctionLatentCommand([this, Payloads, ServerColors]()
+	{
+		TMap<FIntVector, const ABaseGeometryActor*> ClientActors;
+		for (const ABaseGeometryActor* Geometry : GetGeometryActors(FindPIEWorld(NM_Client)))
+		{
+			ClientActors.Add(GetLocationKey(Geometry->GetActorLocation()), Geometry);
+		}
+		TestEqual(TEXT("Client copies"), ClientActors.Num(), Payloads.Num());
+
+		// Within the quantization of FVector_NetQuantize10, FVector_NetQuantize100 and the compressed rotator
+		for (const FGeometryPayload& Payload : Payloads)
+		{
+			const ABaseGeometryActor* const* Copy = ClientActors.Find(GetLocationKey(Payload.InitialTransform.GetLocation()));
+			if (!TestNotNull(TEXT("Client copy at the payload location"), Copy))
+				continue;
+
+			const FTransform Transform = (*Copy)->GetActorTransform();
+			TestTrue(TEXT("Replicated location"), Transform.GetLocation().Equals(Payload.InitialTransform.GetLocation(), 0.1f));
+			TestTrue(TEXT("Replicated rotation"), Transform.Rotator().Equals(Payload.InitialTransform.Rotator(), 0.01f));
+			TestTrue(TEXT("Replicated scale"), Transform.GetScale3D().Equals(Payload.InitialTransform.GetScale3D(), 0.01f));
+		}
+
+		// The hub replicates the colors the shapes push to the event queue, the test listens to the same events
+		UWorld* ServerWorld = FindPIEWorld(NM_ListenServer);
+		UGeometryEventSubsystem* EventSubsystem = ServerWorld ? ServerWorld->GetSubsystem<UGeometryEventSubsystem>() : nullptr;
+		if (TestNotNull(TEXT("Server event subsystem"), EventSubsystem))
+		{
+			EventSubsystem->OnEvents.AddLambda([ServerColors](TConstArrayView<FGeometryEvent> Events)
+			{
+				for (const FGeometryEvent& Event : Events)
+				{
+					if (Event.Type == EGeometryEventType::ColorChanged && Event.Actor.IsValid())
+					{
+						ServerColors->Add(GetLocationKey(Event.Actor->GetActorLocation()), Event.Color);
+					}
+				}
+			});
+		}
+		return true;
+	}));
+
+	// The client catches up with the server colors between two timer ticks
+	ADD_LATENT_AUTOMATION_COMMAND(FUntilCommand([ServerColors]()
+	{
+		const TArray<ABaseGeometryActor*> ClientActors = GetGeometryActors(FindPIEWorld(NM_Client));
+		if (ServerColors->Num() < NumPayloads || ClientActors.Num() < NumPayloads)
+			return false;
+
+		for (const ABaseGeometryActor* Geometry : ClientActors)
+		{
+			const FColor* ServerColor = ServerColors->Find(GetLocationKey(Geometry->GetActorLocation()));
+			if (!ServerColor || Geometry->GetGeometryData().Color.QuantizeRound() != *ServerColor)
+				return false;
+		}
+		return true;
+	}, [this]()
+	{
+		AddError(TEXT("The client colors don't match the server colors"));
+		return true;
+	}, Timeout));
+
+	// The server timers finish after MaxTimerCount colors and the client copies go with them
+	ADD_LATENT_AUTOMATION_COMMAND(FUntilCommand([]()
+	{
+		return GetGeometryActors(FindPIEWorld(NM_Client)).Num() == 0;
+	}, [this]()
+	{
+		AddError(TEXT("The client copies weren't removed"));
+		return true;
+	}, Timeout));
+
+	ADD_LATENT_AUTOMATION_COMMAND(FEndPlayMapCommand());
+	ADD_LATENT_AUTOMATION_COMMAND(FFunctionLatentCommand([PlaySettings, PreviousNetMode, PreviousNumClients, bPreviousRunUnderOneProcess]()
+	{
+		PlaySettings->SetPlayNetMode(PreviousNetMode);
+		PlaySettings->SetPlayNumberOfClients(PreviousNumClients);
+		PlaySettings->SetRunUnderOneProcess(bPreviousRunUnderOneProcess);
+		return true;
+	}));
+	return true;
+}
+
+#endif
+
+#endif
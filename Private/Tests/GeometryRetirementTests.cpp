@@ -0,0 +1,110 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BaseGeometryActor.h"
+#include "EngineUtils.h"
+#include "GeometryHubActor.h"
+#include "GeometryTestWorld.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+// A wave of timers finishing together in a hub with bDeferredRetirement
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FGeometryDeferredRetirementTest, "Project.Geometry.Retirement.Deferred",
+                                 EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FGeometryDeferredRetirementTest::RunTest(const FString& Parameters)
+{
+	constexpr int32 NumPayloads = 500;
+	constexpr int32 MaxFrames = 20000;
+	const float BudgetMs = 0.1f;
+	const float DeltaTime = 1.0f / 30.0f;
+
+	FGeometryTestWorld TestWorld;
+	UWorld* World = TestWorld.Get();
+
+	// Same TimeRate for all of them, the timers of the actors spawned in one frame finish in one frame
+	TArray<FGeometryPayload> Payloads;
+	for (int32 i = 0; i < NumPayloads; ++i)
+	{
+		FGeometryPayload& Payload = Payloads.AddDefaulted_GetRef();
+		Payload.GeometryClass = ABaseGeometryActor::StaticClass();
+		Payload.InitialTransform.SetLocation(FVector(300.0f * (i % 25), 300.0f * (i / 25), 2000.0f));
+		Payload.Data.TimeRate = 0.2f;
+	}
+
+	AGeometryHubActor* Hub = World->SpawnActorDeferred<AGeometryHubActor>(AGeometryHubActor::StaticClass(), FTransform::Identity);
+	if (!TestNotNull(TEXT("Spawned hub"), Hub))
+		return false;
+
+	SetGeometryTestProperty<TSubclassOf<ABaseGeometryActor>>(Hub, TEXT("GeometryClass"), ABaseGeometryActor::StaticClass());
+	SetGeometryTestProperty(Hub, TEXT("GeometryPayloads"), Payloads);
+	SetGeometryTestProperty(Hub, TEXT("bDeferredRetirement"), true);
+	SetGeometryTestProperty(Hub, TEXT("RetireBudgetMs"), BudgetMs);
+	Hub->FinishSpawning(FTransform::Identity);
+
+	// Every shape of the hub, the time-sliced spawning adds them over the first frames
+	TArray<TWeakObjectPtr<ABaseGeometryActor>> Actors;
+	TSet<ABaseGeometryActor*> KnownActors;
+	TArray<TWeakObjectPtr<ABaseGeometryActor>> FinishedThisFrame;
+
+	int32 NumFrames = 0;
+	int32 NumBudgetFrames = 0;
+	int32 MaxQueued = 0;
+	bool bAllDestroyed = false;
+	for (; NumFrames < MaxFrames && !bAllDestroyed; ++NumFrames)
+	{
+		for (TActorIterator<ABaseGeometryActor> It(World); It; ++It)
+		{
+			ABaseGeometryActor* Geometry = *It;
+			if (!KnownActors.Contains(Geometry) && !Geometry->IsHidden())
+			{
+				KnownActors.Add(Geometry);
+				Actors.Add(Geometry);
+				Geometry->OnTimerFinished.AddLambda([&FinishedThisFrame](AActor* Actor)
+				{
+					FinishedThisFrame.Add(Cast<ABaseGeometryActor>(Actor));
+				});
+			}
+		}
+
+		const int32 NumQueuedBefore = Hub->GetNumQueuedRetirements();
+		FinishedThisFrame.Reset();
+		TestWorld.Tick(DeltaTime);
+
+		// Gone for the player in the frame the timer finishes, destroyed later or right away by the budget
+		for (const TWeakObjectPtr<ABaseGeometryActor>& Geometry : FinishedThisFrame)
+		{
+			if (Geometry.IsValid())
+			{
+				TestTrue(TEXT("Finished actor is hidden"), Geometry->IsHidden());
+				TestFalse(TEXT("Finished actor has no collision"), Geometry->GetActorEnableCollision());
+				TestFalse(TEXT("Finished actor doesn't tick"), Geometry->IsActorTickEnabled());
+			}
+		}
+
+		if (NumQueuedBefore > 0)
+		{
+			++NumBudgetFrames;
+			TestTrue(FString::Printf(TEXT("Retirement frame of %.3f ms is within the budget plus one actor of %.3f ms"),
+			                         Hub->GetLastRetireMs(), Hub->GetLastRetireSlowestActorMs()),
+			         Hub->GetLastRetireMs() <= BudgetMs + Hub->GetLastRetireSlowestActorMs());
+		}
+		MaxQueued = FMath::Max(MaxQueued, Hub->GetNumQueuedRetirements());
+
+		bAllDestroyed = Actors.Num() >= NumPayloads && Hub->GetNumQueuedRetirements() == 0 &&
+		                !Actors.ContainsByPredicate([](const TWeakObjectPtr<ABaseGeometryActor>& Geometry) { return Geometry.IsValid(); });
+	}
+
+	TestTrue(TEXT("Every payload was spawned"), Actors.Num() >= NumPayloads);
+	TestTrue(TEXT("The wave was spread over several frames"), NumBudgetFrames > 1);
+	TestEqual(TEXT("Retire queue is empty"), Hub->GetNumQueuedRetirements(), 0);
+	TestTrue(TEXT("Every actor was destroyed"), bAllDestroyed);
+
+	AddInfo(FString::Printf(TEXT("%d actors retired over %d frames of the budget, at most %d queued, done after %d frames"), Actors.Num(),
+	                        NumBudgetFrames, MaxQueued, NumFrames));
+	return true;
+}
+
+#endif
@@ -0,0 +1,59 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "UObject/UnrealType.h"
+
+/**
+ * @brief Game world of an automation test, playing from the constructor and destroyed with the object.
+ * The world doesn't tick by itself, Tick runs one frame of it.
+ */
+class FGeometryTestWorld
+{
+public:
+	FGeometryTestWorld()
+	{
+		World = UWorld::CreateWorld(EWorldType::Game, false);
+		FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+		WorldContext.SetCurrentWorld(World);
+
+		World->InitializeActorsForPlay(FURL());
+		World->BeginPlay();
+	}
+
+	~FGeometryTestWorld()
+	{
+		GEngine->DestroyWorldContext(World);
+		World->DestroyWorld(false);
+	}
+
+	FGeometryTestWorld(const FGeometryTestWorld&) = delete;
+	FGeometryTestWorld& operator=(const FGeometryTestWorld&) = delete;
+
+	UWorld* Get() const { return World; }
+
+	void Tick(float DeltaTime = 1.0f / 60.0f)
+	{
+		World->Tick(LEVELTICK_All, DeltaTime);
+	}
+
+private:
+	UWorld* World = nullptr;
+};
+
+// Sets a protected UPROPERTY of Object, as the editor does
+template <typename ValueType>
+void SetGeometryTestProperty(UObject* Object, const TCHAR* Name, const ValueType& Value)
+{
+	const FProperty* Property = Object->GetClass()->FindPropertyByName(Name);
+	check(Property);
+	*Property->ContainerPtrToValuePtr<ValueType>(Object) = Value;
+}
+
+#endif
@@ -9,12 +9,16 @@
 // Inherited publicly from the actor, so we need to specify the header file where actor is declared.
 #include "GameFramework/Actor.h"
 #include "Components//StaticMeshComponent.h"
+#include "GeometryRandom.h"
 // BaseGeometryActor.generated.h is the auto-generated header.
 // The engine generates it for each actor
 // there is meta information about the class and it must go the very last in the list of all includes
 // if we want to add some additional include, then we must include it before.
 #include "BaseGeometryActor.generated.h"
 
+class UMaterialInstanceDynamic;
+class UGeometryEventSubsystem;
+
 // F：用于结构体（struct）。例如，FVector、FRotator、FLinearColor。
 // A：用于表示Actor类。例如，AActor、AMyActor。
 // U：用于表示UObject类或其子类。例如，UObject、UStaticMesh、UTexture。
@@ -27,12 +31,23 @@ DECLARE_MULTICAST_DELEGATE_OneParam(FOnTimerFinished, AActor*);
 
 /**
  * @brief An enumeration class for different movement types.
+ * Every moving type is a model of GeometryMovement::FindModel, see GeometryMovementModels.h.
  */
 UENUM(BlueprintType)
 enum class EMovementType: uint8
 {
 	Sin,
-	Static
+	Static,
+	// Circle of radius Amplitude around the initial location, Frequency in radians per second
+	Orbit,
+	// Hops of height Amplitude above the initial location
+	Bounce,
+	// 3:2 Lissajous figure of size Amplitude
+	Lissajous,
+	// Without a model until game code binds one with GeometryMovement::RegisterModel
+	Custom1 UMETA(DisplayName="Custom 1"),
+	Custom2 UMETA(DisplayName="Custom 2"),
+	Custom3 UMETA(DisplayName="Custom 3")
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -78,10 +93,8 @@ public:
 	UPROPERTY(VisibleAnywhere)
 	UStaticMeshComponent* BaseMesh;
 
-	void SetGeometryData(const FGeometryData& Data)
-	{
-		GeometryData = Data;
-	}
+	// On a started actor the live actor stats switch to the new move type right away
+	void SetGeometryData(const FGeometryData& Data);
 
 	// can be called in blueprint
 	UFUNCTION(BlueprintCallable)
@@ -94,6 +107,55 @@ public:
 
 	FOnTimerFinished OnTimerFinished;
 
+	/** @brief Switches between pushing events to UGeometryEventSubsystem and broadcasting the delegates only. */
+	void SetUseEventQueue(bool bUse);
+
+	/**
+	 * @brief Brings a deactivated (pooled) actor back into the game with new data,
+	 * as if it had just been spawned at the given transform.
+	 */
+	void ActivateGeometry(const FTransform& Transform, const FGeometryData& Data);
+
+	/** @brief Hides the actor and stops its timer and movement, so it can be kept in a pool instead of being destroyed. */
+	void DeactivateGeometry();
+
+	/**
+	 * @brief Makes the actor a client copy of a shape replicated by AGeometryHubActor: it still moves itself,
+	 * but runs no color timer, its colors come from ApplyReplicatedColor. Must be called before FinishSpawning.
+	 */
+	void SetDrivenByReplication(bool bDriven) { bDrivenByReplication = bDriven; }
+
+	void ApplyReplicatedColor(const FLinearColor& Color);
+
+	/** @brief Logs the transform as Verbose lines of LogBaseGeometry, builds no string while they are inactive. */
+	void PrintTransform();
+
+	/**
+	 * @brief Seeds the color stream from a key which is the same in every session, e.g. the index of the payload or layout record
+	 * the actor was spawned for. Call it before FinishSpawning, or right after a pooled actor was activated.
+	 */
+	void SetRandomKey(uint64 Key);
+
+	/**
+	 * @brief Location of the shape at the given world time according to its movement formula.
+	 * Use it instead of GetActorLocation for Sin shapes in GPU movement mode, whose transform never changes.
+	 */
+	UFUNCTION(BlueprintCallable)
+	FVector GetGeometryLocationAtTime(float Time) const;
+
+	/** @brief GetGeometryLocationAtTime at GeometryKernels::GetMovementTime, the server time on clients. */
+	UFUNCTION(BlueprintCallable)
+	FVector GetGeometryLocation() const;
+
+	bool IsGPUMovementActive() const { return bGPUMovementActive; }
+
+	/**
+	 * @brief Checks the GPU movement setup without rendering anything, so it also works with -nullrhi:
+	 * the transform is untouched, the material parameters match the data and the CPU query matches the kernel.
+	 * @return false and the reason in OutError if something doesn't match
+	 */
+	bool ValidateGPUMovement(FString& OutError) const;
+
 protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
@@ -104,6 +166,29 @@ protected:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="GeometryData")
 	FGeometryData GeometryData;
 
+	// If set, the movement is driven by UGeometryMovementSubsystem in one batch per movement type and the actor does not tick itself
+	UPROPERTY(EditAnywhere, Category="Movement")
+	bool bUseBatchedMovement = true;
+
+	// If set, Sin movement is evaluated by the World Position Offset of the material and the transform is never updated on the CPU.
+	// The material must offset Z by SinAmplitude * sin(SinFrequency * Time) (Sine node with a period of 2 pi) and read the
+	// parameters "SinAmplitude" and "SinFrequency". Takes precedence over bUseBatchedMovement.
+	UPROPERTY(EditAnywhere, Category="Movement")
+	bool bUseGPUMovement = false;
+
+	// If set, the color timer runs in UGeometryTimerSubsystem together with the other actors of the same TimeRate
+	// instead of registering its own timer in the world timer manager
+	UPROPERTY(EditAnywhere, Category="Design")
+	bool bUseTimerWheel = true;
+
+	// If set, color changes and the end of the timer are also pushed to UGeometryEventSubsystem as compact records.
+	// OnColorChanged is then only broadcast if something is bound to it.
+	UPROPERTY(EditAnywhere, Category="Design")
+	bool bUseEventQueue = false;
+
+#if WITH_EDITORONLY_DATA
+	// Demo fields of the tutorial, only read by PrintType and PrintStringType.
+	// Editor only, so cooked builds don't carry them in every geometry actor.
 	// UPPROPERTY has following parameters:
 	UPROPERTY(EditAnywhere, Category="Weapon")
 	int32 WeaponsNum = 4;
@@ -119,21 +204,71 @@ protected:
 
 	UPROPERTY(VisibleAnywhere, Category="Weapon")
 	bool HasWeapon = true;
+#endif
 
 public:
 	// Called every frame
 	virtual void Tick(float DeltaTime) override;
 
 private:
+	friend class UGeometryMovementSubsystem;
+	friend class UGeometryTimerSubsystem;
+
 	FVector Initiallocation;
 	FTimerHandle TimerHandle;
 
+	// Created once in BeginPlay, SetColor only updates its parameters
+	UPROPERTY(Transient)
+	UMaterialInstanceDynamic* DynMaterial;
+
+	// Index in the UGeometryMovementSubsystem buffers, INDEX_NONE if the actor moves itself
+	int32 MovementIndex = INDEX_NONE;
+
+	// Set between StartGPUMovement and StopGPUMovement
+	bool bGPUMovementActive = false;
+	float DefaultBoundsScale = 1.0f;
+
+	// Movement type group and index in it in UGeometryMovementSubsystem, for the movement types other than Sin
+	int32 MovementGroup = INDEX_NONE;
+	int32 MovementGroupIndex = INDEX_NONE;
+
+	// Index in the ticking actors of UGeometryMovementSubsystem, which throttle the tick of the actor by significance
+	int32 TickingIndex = INDEX_NONE;
+
+	// Client copy of a replicated shape, see SetDrivenByReplication
+	bool bDrivenByReplication = false;
+
+	// Set between StartGeometry and StopGeometry, the live actor stats count the move type of the last data set in between
+	bool bGeometryStarted = false;
+	EMovementType CountedMoveType = EMovementType::Static;
+
+	// Cached in StartGeometry when bUseEventQueue is set
+	UPROPERTY(Transient)
+	UGeometryEventSubsystem* EventSubsystem;
+
+	// Bucket and slot in UGeometryTimerSubsystem, INDEX_NONE if the fallback TimerHandle is used
+	int32 TimerBucket = INDEX_NONE;
+	int32 TimerSlot = INDEX_NONE;
+
 	const int32 MaxTimerCount = 5;
 	int32 TimerCount = 0;
 
+	// Own random stream for the timer colors, seeded in StartGeometry from the run seed
+	FGeometryRandomStream ColorStream;
+	// Set by SetRandomKey, otherwise the stream is keyed by the actor itself, see SeedColorStream
+	TOptional<uint64> RandomKey;
+
+	void SeedColorStream();
+
+	void StartGeometry();
+	void StopGeometry();
+	bool StartGPUMovement();
+	void StopGPUMovement();
+	void StartTimer();
+	void StopTimer();
+	void CreateDynamicMaterial();
 	void PrintType();
 	void PrintStringType();
-	void PrintTransform();
 	void HandleMovement();
 	void SetColor(const FLinearColor& Color);
 	void OnTimerFired();
@@ -0,0 +1,97 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Object.h"
+#include "UObject/ObjectKey.h"
+#include "BaseGeometryActor.h"
+#include "GeometryActorPool.generated.h"
+
+USTRUCT(BlueprintType)
+struct FGeometryActorPoolStats
+{
+	GENERATED_BODY()
+
+	// Number of Acquire calls
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Pool")
+	int32 NumAcquired = 0;
+
+	// Acquire calls served by a pooled actor
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Pool")
+	int32 NumHits = 0;
+
+	// Acquire calls that had to spawn a new actor
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Pool")
+	int32 NumMisses = 0;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Pool")
+	int32 NumReleased = 0;
+
+	// Largest number of inactive actors held by the pool at once
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Pool")
+	int32 PeakFreeActors = 0;
+
+	// Largest number of actors owned by the pool at once, active and inactive
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Pool")
+	int32 PeakTotalActors = 0;
+
+	float GetHitRate() const { return NumAcquired > 0 ? static_cast<float>(NumHits) / NumAcquired : 0.0f; }
+};
+
+USTRUCT()
+struct FGeometryActorPoolList
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<ABaseGeometryActor*> FreeActors;
+};
+
+/**
+ * @brief Keeps deactivated geometry actors per class and hands them out again instead of spawning new ones.
+ *
+ * Released actors are hidden and stopped (see ABaseGeometryActor::DeactivateGeometry), not destroyed,
+ * so cycling geometry doesn't churn UObject allocations and garbage collection.
+ */
+UCLASS()
+class CPP_TUTORIAL_API UGeometryActorPool : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	/** @brief Spawns Count inactive actors of the class up front. */
+	void Prewarm(TSubclassOf<ABaseGeometryActor> GeometryClass, int32 Count);
+
+	/**
+	 * @brief Returns an active actor of the class with the given transform and data.
+	 * A pooled actor is reused if there is one, otherwise a new actor is spawned.
+	 */
+	ABaseGeometryActor* Acquire(TSubclassOf<ABaseGeometryActor> GeometryClass, const FTransform& Transform, const FGeometryData& Data);
+
+	/**
+	 * @brief Deactivates the actor and keeps it for the next Acquire of its class.
+	 * @return false for an actor the pool didn't spawn, which is left alone
+	 */
+	bool Release(ABaseGeometryActor* Actor);
+
+	/** @brief Destroys all the inactive actors. */
+	void Clear();
+
+	const FGeometryActorPoolStats& GetStats() const { return Stats; }
+
+private:
+	ABaseGeometryActor* SpawnGeometry(TSubclassOf<ABaseGeometryActor> GeometryClass, const FTransform& Transform, const FGeometryData& Data);
+	void UpdatePeaks();
+
+	UPROPERTY()
+	TMap<TSubclassOf<ABaseGeometryActor>, FGeometryActorPoolList> Pools;
+
+	FGeometryActorPoolStats Stats;
+
+	// Every live actor spawned by the pool, true while it is handed out by Acquire
+	TMap<TObjectKey<ABaseGeometryActor>, bool> PooledActors;
+
+	int32 NumFreeActors = 0;
+	int32 NumActiveActors = 0;
+};
@@ -0,0 +1,80 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "BaseGeometryActor.h"
+#include "GeometryBenchmarkSubsystem.generated.h"
+
+/**
+ * @brief Spawns N geometry actors per movement type and records spawn time, frame times and memory per actor.
+ *
+ * The memory per actor is the object memory of the actor and its components, see GetActorMemoryBytes.
+ *
+ * Started with the geometry.Benchmark.Run console command, so it also runs headless, e.g.
+ *   UnrealEditor Project.uproject Map -game -nullrhi -unattended -nosound -ExecCmds="t.MaxFPS 0, geometry.Benchmark.Run 100+1000+10000+100000 120 -exit"
+ * The results are written as JSON to Saved/Benchmarks/GeometryBenchmark.json for CI to diff against a baseline.
+ */
+UCLASS()
+class CPP_TUTORIAL_API UGeometryBenchmarkSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	/**
+	 * @brief Starts a run over every actor count and every movement type of GetBenchmarkedMoveTypes.
+	 * @param bExitWhenDone request the engine exit after the results have been written
+	 * @param bWriteResults write the JSON file at the end, the automation tests only read GetCases
+	 */
+	void StartBenchmark(const TArray<int32>& ActorCounts, int32 NumFrames, bool bExitWhenDone, bool bWriteResults = true);
+
+	bool IsRunning() const { return CaseIndex != INDEX_NONE; }
+
+	/** @brief Static and every movement type with a model, including the custom ones bound by game code. */
+	static TArray<EMovementType> GetBenchmarkedMoveTypes();
+
+	/**
+	 * @brief Bytes of the actor and its components as counted by FArchiveCountMem: the objects themselves and the containers they own.
+	 * Shared meshes and materials and the render proxies are not counted.
+	 */
+	static SIZE_T GetActorMemoryBytes(const AActor* Actor);
+
+	struct FCase
+	{
+		int32 NumActors = 0;
+		EMovementType MoveType = EMovementType::Static;
+
+		double SpawnMs = 0.0;
+		double AverageFrameMs = 0.0;
+		double P99FrameMs = 0.0;
+		double BytesPerActor = 0.0;
+	};
+
+	// Results of the last run, complete once IsRunning is false
+	const TArray<FCase>& GetCases() const { return Cases; }
+
+private:
+	void BeginCase();
+	void EndCase();
+	void WriteResults() const;
+
+	// Frames skipped after the spawn before the frame times are recorded
+	static constexpr int32 NumWarmupFrames = 10;
+
+	TArray<FCase> Cases;
+	int32 CaseIndex = INDEX_NONE;
+	int32 NumFramesPerCase = 120;
+	bool bExit = false;
+	bool bWrite = true;
+
+	// Referenced, so an actor destroyed by someone else during the case is nulled by the GC instead of left dangling
+	UPROPERTY()
+	TArray<ABaseGeometryActor*> SpawnedActors;
+	TArray<double> FrameTimes;
+	double LastFrameTime = 0.0;
+	int32 FrameCounter = 0;
+};
@@ -0,0 +1,69 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include <atomic>
+#include "GeometryEventSubsystem.generated.h"
+
+class ABaseGeometryActor;
+
+UENUM()
+enum class EGeometryEventType : uint8
+{
+	ColorChanged,
+	TimerFinished
+};
+
+/**
+ * @brief Compact record of one geometry event, 16 bytes.
+ */
+struct FGeometryEvent
+{
+	TWeakObjectPtr<ABaseGeometryActor> Actor;
+	// Linear color packed with QuantizeRound, the same packing as the replicated color, so it is quantized only once
+	FColor Color;
+	EGeometryEventType Type = EGeometryEventType::ColorChanged;
+};
+
+// All the events of one frame in the order they were pushed
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnGeometryEvents, TConstArrayView<FGeometryEvent>);
+
+/**
+ * @brief Per-frame queue of geometry events, an alternative to the per-actor OnColorChanged / OnTimerFinished delegates.
+ *
+ * Actors push POD records into a preallocated buffer with one atomic increment, so pushing is lock-free and
+ * allowed from worker threads. Once per frame the listeners get all the events as one span, the events they push
+ * themselves come in the span of the next frame. Other pushes must not overlap with the flush in Tick, which runs
+ * on the game thread.
+ */
+UCLASS()
+class CPP_TUTORIAL_API UGeometryEventSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	void Push(ABaseGeometryActor* Actor, EGeometryEventType Type, const FLinearColor& Color = FLinearColor::Black);
+
+	FOnGeometryEvents OnEvents;
+
+private:
+	void Flush();
+
+	// Initial number of events per frame that fit without taking the overflow lock
+	static constexpr int32 InitialCapacity = 1024;
+
+	TArray<FGeometryEvent> Buffer;
+	std::atomic<int32> WriteIndex{0};
+	// The events of the last flush, swapped with Buffer so the listeners can push during the broadcast
+	TArray<FGeometryEvent> BroadcastBuffer;
+
+	// Events that didn't fit into Buffer. They are appended in Flush and the buffer keeps the larger size afterwards.
+	FCriticalSection OverflowLock;
+	TArray<FGeometryEvent> Overflow;
+};
@@ -0,0 +1,156 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Templates/Function.h"
+
+/**
+ * @brief Linear allocator for the transient arrays of the geometry code on the game thread, reset at the beginning of every frame.
+ *
+ * An allocation is a pointer bump, nothing is freed before the reset. The memory comes from blocks which are kept across frames:
+ * once the arena has grown to the largest frame, the frames don't touch the heap any more. If a frame needed more than
+ * one block, the blocks are merged into one at the next reset.
+ *
+ * Nothing allocated from the arena may outlive the function which allocated it, see TGeometryFrameArray.
+ */
+class CPP_TUTORIAL_API FGeometryFrameArena
+{
+public:
+	// Size of the first block
+	static constexpr SIZE_T DefaultBlockSize = 64 * 1024;
+
+	/** @brief The arena of the game thread. */
+	static FGeometryFrameArena& Get();
+
+	void* Allocate(SIZE_T Size, uint32 Alignment);
+
+	/** @brief Grows or shrinks the last allocation in place when it fits, otherwise copies NumBytesToCopy into a new allocation. */
+	void* Reallocate(void* Data, SIZE_T NumBytesToCopy, SIZE_T NewSize, uint32 Alignment);
+
+	/** @brief Frees everything allocated since the last reset, called at the beginning of every frame. */
+	void Reset();
+
+	// Bytes allocated since the last reset, with alignment padding and the unused ends of full blocks
+	SIZE_T GetUsedBytes() const { return UsedBytes; }
+	SIZE_T GetHighWaterMark() const { return HighWaterMark; }
+	SIZE_T GetCapacity() const;
+	// Blocks taken from the heap since the start, constant in steady state
+	int32 GetNumBlockAllocations() const { return NumBlockAllocations; }
+
+	void ResetHighWaterMark() { HighWaterMark = UsedBytes; }
+
+private:
+	FGeometryFrameArena();
+
+	void BeginFrame();
+
+	struct FBlock
+	{
+		uint8* Data = nullptr;
+		SIZE_T Size = 0;
+	};
+
+	void AddBlock(SIZE_T Size);
+
+	TArray<FBlock> Blocks;
+	int32 CurrentBlock = 0;
+	SIZE_T BlockOffset = 0;
+	SIZE_T UsedBytes = 0;
+	SIZE_T HighWaterMark = 0;
+	int32 NumBlockAllocations = 0;
+
+	// The only allocation which can grow in place
+	uint8* LastAllocation = nullptr;
+};
+
+/**
+ * @brief TArray allocator taking its memory from FGeometryFrameArena, same as TMemStackAllocator for FMemStack.
+ * Growing an array copies it into a new allocation unless it is the last one of the arena, the old memory is only reclaimed
+ * at the next reset.
+ */
+class FGeometryFrameAllocator
+{
+public:
+	using SizeType = int32;
+
+	enum { NeedsElementType = true };
+	enum { RequireRangeCheck = true };
+
+	template <typename ElementType>
+	class ForElementType
+	{
+	public:
+		ForElementType() = default;
+
+		FORCEINLINE void MoveToEmpty(ForElementType& Other)
+		{
+			checkSlow(this != &Other);
+
+			Data = Other.Data;
+			Other.Data = nullptr;
+		}
+
+		FORCEINLINE ElementType* GetAllocation() const
+		{
+			return Data;
+		}
+
+		void ResizeAllocation(SizeType CurrentNum, SizeType NewMax, SIZE_T NumBytesPerElement)
+		{
+			if (NewMax == 0)
+			{
+				Data = nullptr;
+				return;
+			}
+
+			Data = static_cast<ElementType*>(FGeometryFrameArena::Get().Reallocate(Data, CurrentNum * NumBytesPerElement, NewMax * NumBytesPerElement,
+			                                                                         alignof(ElementType)));
+		}
+
+		SizeType CalculateSlackReserve(SizeType NewMax, SIZE_T NumBytesPerElement) const
+		{
+			return DefaultCalculateSlackReserve(NewMax, NumBytesPerElement, false, alignof(ElementType));
+		}
+
+		SizeType CalculateSlackShrink(SizeType NewMax, SizeType CurrentMax, SIZE_T NumBytesPerElement) const
+		{
+			return DefaultCalculateSlackShrink(NewMax, CurrentMax, NumBytesPerElement, false, alignof(ElementType));
+		}
+
+		SizeType CalculateSlackGrow(SizeType NewMax, SizeType CurrentMax, SIZE_T NumBytesPerElement) const
+		{
+			return DefaultCalculateSlackGrow(NewMax, CurrentMax, NumBytesPerElement, false, alignof(ElementType));
+		}
+
+		SIZE_T GetAllocatedSize(SizeType CurrentMax, SIZE_T NumBytesPerElement) const
+		{
+			return CurrentMax * NumBytesPerElement;
+		}
+
+		bool HasAllocation() const
+		{
+			return Data != nullptr;
+		}
+
+		SizeType GetInitialCapacity() const
+		{
+			return 0;
+		}
+
+	private:
+		ElementType* Data = nullptr;
+	};
+
+	typedef ForElementType<FScriptContainerElement> ForAnyElementType;
+};
+
+template <>
+struct TAllocatorTraits<FGeometryFrameAllocator> : TAllocatorTraitsBase<FGeometryFrameAllocator>
+{
+	enum { SupportsMove = true };
+};
+
+// Array for the results and scratch data of one call on the game thread, e.g. the actors found by a spatial query
+template <typename ElementType>
+using TGeometryFrameArray = TArray<ElementType, FGeometryFrameAllocator>;
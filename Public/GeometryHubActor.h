@@ -5,8 +5,26 @@
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
 #include "BaseGeometryActor.h"
+#include "GeometryActorPool.h"
+#include "GeometryEventSubsystem.h"
+#include "GeometryFrameArena.h"
+#include "GeometryInstanceRendererComponent.h"
+#include "GeometryLayoutFile.h"
+#include "GeometryMovementSubsystem.h"
+#include "GeometryReplication.h"
+#include "GeometrySpatialHash.h"
+#include "Engine/StreamableManager.h"
 #include "GeometryHubActor.generated.h"
 
+UENUM(BlueprintType)
+enum class EGeometryBackend : uint8
+{
+	// A full ABaseGeometryActor per shape
+	Actor,
+	// A Mass entity drawn by the hub's InstanceRenderer, see UGeometryMassSubsystem
+	MassEntity
+};
+
 USTRUCT(BlueprintType)
 struct FGeometryPayload
 {
@@ -15,13 +33,32 @@ struct FGeometryPayload
 	UPROPERTY(EditAnywhere)
 	TSubclassOf<ABaseGeometryActor> GeometryClass;
 
+	// Used when GeometryClass is not set. The time-sliced spawning loads these classes asynchronously.
+	UPROPERTY(EditAnywhere)
+	TSoftClassPtr<ABaseGeometryActor> SoftGeometryClass;
+
 	UPROPERTY(EditAnywhere)
 	FGeometryData Data;
 
 	UPROPERTY(EditAnywhere)
 	FTransform InitialTransform;
+
+	UPROPERTY(EditAnywhere)
+	EGeometryBackend Backend = EGeometryBackend::Actor;
 };
 
+// Spawn items of the hub (see GetNumSpawnItems) within one streaming cell, and their actors while the cell is loaded
+struct FGeometryStreamingCell
+{
+	TArray<int32> Items;
+	// Parallel to the first items while the cell is loaded, the others are still waiting in the spawn queue of the hub
+	TArray<TWeakObjectPtr<ABaseGeometryActor>> Actors;
+	bool bLoaded = false;
+	bool bSpawnQueued = false;
+};
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnGeometrySpawnCompleted, int32, NumPayloads);
+
 UCLASS()
 class CPP_TUTORIAL_API AGeometryHubActor : public AActor
 {
@@ -31,10 +68,51 @@ public:
 	// Sets default values for this actor's properties
 	AGeometryHubActor();
 
+	UFUNCTION(BlueprintCallable)
+	FGeometryActorPoolStats GetPoolStats() const;
+
+	// All the geometry actors spawned by the hub whose location is within Radius of Center
+	UFUNCTION(BlueprintCallable)
+	TArray<ABaseGeometryActor*> QueryGeometryInSphere(const FVector& Center, float Radius) const;
+
+	// All the geometry actors spawned by the hub whose location is inside Box
+	UFUNCTION(BlueprintCallable)
+	TArray<ABaseGeometryActor*> QueryGeometryInBox(const FBox& Box) const;
+
+	// Same as the queries above, the results are appended to OutActors instead of a new array
+	void CollectGeometryInSphere(const FVector& Center, float Radius, TArray<ABaseGeometryActor*>& OutActors) const;
+	void CollectGeometryInBox(const FBox& Box, TArray<ABaseGeometryActor*>& OutActors) const;
+	// For per-frame code: the results live in the frame arena and don't touch the heap
+	void CollectGeometryInSphere(const FVector& Center, float Radius, TGeometryFrameArray<ABaseGeometryActor*>& OutActors) const;
+	void CollectGeometryInBox(const FBox& Box, TGeometryFrameArray<ABaseGeometryActor*>& OutActors) const;
+
+	// Turns the Mass entity shapes within Radius of Center into actors, for gameplay that needs a real actor
+	UFUNCTION(BlueprintCallable)
+	TArray<ABaseGeometryActor*> PromoteMassGeometryInSphere(const FVector& Center, float Radius);
+
+	// Fired when all the GeometryPayloads have been spawned
+	UPROPERTY(BlueprintAssignable)
+	FOnGeometrySpawnCompleted OnSpawnCompleted;
+
+	// Bytes per second sent (server) or received (client) for the replicated geometry, updated once per second
+	UFUNCTION(BlueprintCallable)
+	float GetReplicationBytesPerSecond() const { return ReplicationBytesPerSecond; }
+
+	// Actors deactivated by bDeferredRetirement and not destroyed yet
+	int32 GetNumQueuedRetirements() const { return RetireQueue.Num() - RetireQueueHead; }
+
+	// Milliseconds spent by the last frame on destroying queued actors, and by the slowest of those actors
+	double GetLastRetireMs() const { return LastRetireMs; }
+	double GetLastRetireSlowestActorMs() const { return LastRetireSlowestActorMs; }
+
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
 protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 	// TSubclassOf will filter out all the available classes of the engine
 	// and in the property it will be possible to set only the BaseGeometryActor class
 	// or the classes that inherits from it.
@@ -52,13 +130,199 @@ protected:
 	UPROPERTY(EditAnywhere)
 	TArray<FGeometryPayload> GeometryPayloads;
 
+	// If set, payload actors are taken from a pool and returned to it when their timer finishes instead of being destroyed
+	UPROPERTY(EditAnywhere, Category="Pool")
+	bool bUseActorPool = false;
+
+	// Number of inactive actors spawned at BeginPlay for every geometry class used by the hub
+	UPROPERTY(EditAnywhere, Category="Pool", meta=(EditCondition="bUseActorPool", ClampMin="0"))
+	int32 PoolPrewarmCount = 0;
+
+	// If set, actors whose timer finished are hidden and disabled right away but destroyed over the next frames,
+	// at most RetireBudgetMs per frame, instead of all in the frame a wave of timers finishes. Pooled actors are not queued.
+	// This spreads the cost of Destroy and of unregistering the components; the garbage collection still frees the same
+	// objects later, its pause doesn't get shorter.
+	UPROPERTY(EditAnywhere, Category="Lifecycle")
+	bool bDeferredRetirement = false;
+
+	// Time in milliseconds the hub may spend on destroying retired actors per frame
+	UPROPERTY(EditAnywhere, Category="Lifecycle", meta=(EditCondition="bDeferredRetirement", ClampMin="0.01", Units="ms"))
+	float RetireBudgetMs = 0.5f;
+
+	// Cell size of the spatial index used by the QueryGeometry functions
+	UPROPERTY(EditAnywhere, Category="Spatial", meta=(ClampMin="1.0"))
+	float SpatialCellSize = 1000.0f;
+
+	// If set, the demo shapes, the pool prewarm and GeometryPayloads are spawned over several frames instead of all at once in BeginPlay
+	UPROPERTY(EditAnywhere, Category="Spawning")
+	bool bTimeSlicedSpawning = false;
+
+	// Binary layout (see geometry.Layout.Convert) spawned after GeometryPayloads. The file is memory-mapped and its records
+	// go straight into the spawning, they are never copied into GeometryPayloads.
+	UPROPERTY(EditAnywhere, Category="Spawning", meta=(FilePathFilter="bin", RelativeToGameDir))
+	FFilePath LayoutFile;
+
+	// Backend of the shapes spawned from LayoutFile
+	UPROPERTY(EditAnywhere, Category="Spawning")
+	EGeometryBackend LayoutBackend = EGeometryBackend::Actor;
+
+	// Time in milliseconds the hub may spend on spawning per frame
+	UPROPERTY(EditAnywhere, Category="Spawning", meta=(EditCondition="bTimeSlicedSpawning", ClampMin="0.1", Units="ms"))
+	float SpawnBudgetMs = 2.0f;
+
+	// If set, payload actors report color changes and finished timers through UGeometryEventSubsystem,
+	// the hub handles all the events of a frame at once instead of one delegate call per event
+	UPROPERTY(EditAnywhere, Category="Events")
+	bool bUseEventQueue = false;
+
+	// If set, payloads are drawn as instances of one instanced mesh per geometry class instead of being spawned as actors
+	UPROPERTY(EditAnywhere, Category="Rendering")
+	bool bUseInstancedRendering = false;
+
+	UPROPERTY(VisibleAnywhere, Category="Rendering")
+	UGeometryInstanceRendererComponent* InstanceRenderer;
+
+	// If set, SignificanceSettings replace the distance buckets of UGeometryMovementSubsystem for the whole world
+	UPROPERTY(EditAnywhere, Category="Significance")
+	bool bOverrideSignificanceSettings = false;
+
+	UPROPERTY(EditAnywhere, Category="Significance", meta=(EditCondition="bOverrideSignificanceSettings"))
+	FGeometrySignificanceSettings SignificanceSettings;
+
+	// If set, the server replicates the actor shapes of the hub: clients spawn nothing themselves, they get a copy of every
+	// shape the server spawns and run its Sin motion locally from the server time. Shapes drawn as instances or Mass entities
+	// are not replicated.
+	UPROPERTY(EditAnywhere, Category="Replication")
+	bool bReplicateGeometry = false;
+
+	// If set, the actor shapes of GeometryPayloads and LayoutFile are only spawned while a player pawn is near their cell,
+	// and released (see bUseActorPool, bDeferredRetirement) once every pawn is far from it. Shapes with another backend
+	// are spawned at BeginPlay as before.
+	UPROPERTY(EditAnywhere, Category="Streaming")
+	bool bStreamPayloadCells = false;
+
+	// Size of the square cells in the XY plane
+	UPROPERTY(EditAnywhere, Category="Streaming", meta=(EditCondition="bStreamPayloadCells", ClampMin="100.0", Units="cm"))
+	float StreamingCellSize = 5000.0f;
+
+	// A cell is loaded when a player pawn comes within this distance of it
+	UPROPERTY(EditAnywhere, Category="Streaming", meta=(EditCondition="bStreamPayloadCells", ClampMin="0.0", Units="cm"))
+	float StreamInRadius = 10000.0f;
+
+	// A loaded cell is released when every player pawn is farther than this. The margin over StreamInRadius keeps a pawn
+	// moving along a border from loading and releasing the same cell every few frames.
+	UPROPERTY(EditAnywhere, Category="Streaming", meta=(EditCondition="bStreamPayloadCells", ClampMin="0.0", Units="cm"))
+	float StreamOutRadius = 12000.0f;
+
+	// Time in milliseconds the hub may spend per frame on spawning the actors of the loaded cells
+	UPROPERTY(EditAnywhere, Category="Streaming", meta=(EditCondition="bStreamPayloadCells", ClampMin="0.1", Units="ms"))
+	float StreamingSpawnBudgetMs = 1.0f;
+
 public:
 	// Called every frame
 	virtual void Tick(float DeltaTime) override;
 
 private:
+	friend struct FGeometryReplicatedItem;
+
 	UFUNCTION()
 	void OnColorChanged(const FLinearColor& Color, const FString& Name);
 	void OnTimerFinished(AActor* Actor);
+	void OnGeometryEvents(TConstArrayView<FGeometryEvent> Events);
+	void BindGeometry(ABaseGeometryActor* Geometry);
 	void DoActorSpawn();
+	// Index 0 to NumDemoActors - 1, the first half in the lower row
+	void SpawnDemoActor(int32 Index);
+	// Fills PendingPrewarm with PoolPrewarmCount actors for every class used by the hub
+	void QueuePoolPrewarm();
+	void PrewarmPool();
+	ABaseGeometryActor* SpawnPayload(const FGeometryPayload& Payload, int32 SpawnIndex);
+	// SpawnIndex keys the random stream of the actor, see MakeRandomKey
+	ABaseGeometryActor* SpawnGeometry(TSubclassOf<ABaseGeometryActor> PayloadClass, const FTransform& Transform, const FGeometryData& Data,
+	                                  EGeometryBackend Backend, int32 SpawnIndex);
+	// Same in every session: the hub is placed in its level and the index is the one of the item, negative for the demo shapes
+	uint64 MakeRandomKey(int32 SpawnIndex) const;
+	TSubclassOf<ABaseGeometryActor> ResolvePayloadClass(const FGeometryPayload& Payload) const;
+	void OpenLayout();
+	void ResolveLayoutClasses();
+	void CloseLayout();
+	// GeometryPayloads followed by the layout records
+	int32 GetNumSpawnItems() const;
+	void SpawnItem(int32 Index);
+	ABaseGeometryActor* SpawnItemGeometry(int32 Index);
+	bool IsStreamedItem(int32 Index) const;
+	FVector GetSpawnItemLocation(int32 Index) const;
+	// Loads the cells near a player pawn and releases the loaded cells far from all of them
+	void UpdateStreamingCells();
+	// Queues the items of the cell for SpawnStreamedItemsWithinBudget
+	void LoadStreamingCell(const FIntPoint& CellKey, FGeometryStreamingCell& Cell);
+	void UnloadStreamingCell(FGeometryStreamingCell& Cell);
+	void SpawnStreamedItemsWithinBudget();
+	// The item of a finished actor is not spawned again when its cell is reloaded
+	void RemoveStreamedActor(ABaseGeometryActor* Geometry);
+	void StartPayloadSpawning();
+	void OnPayloadClassesLoaded();
+	void SpawnPayloadsWithinBudget();
+	// Adds an actor of the hub to the spatial index and, on a replicating server, to ReplicatedGeometry
+	void TrackGeometry(ABaseGeometryActor* Geometry);
+	void UntrackGeometry(ABaseGeometryActor* Geometry);
+	bool IsReplicatingGeometry() const;
+	// Client side of ReplicatedGeometry
+	void SpawnReplicatedGeometry(FGeometryReplicatedItem& Item);
+	void DestroyReplicatedGeometry(ABaseGeometryActor* Geometry);
+	void UpdateReplicationBandwidth();
+	// Returns a finished actor to the pool, otherwise destroys it with DestroyGeometry
+	void RetireGeometry(ABaseGeometryActor* Geometry);
+	// Destroys the actor now or queues it for RetireWithinBudget, see bDeferredRetirement
+	void DestroyGeometry(ABaseGeometryActor* Geometry);
+	void RetireWithinBudget();
+	void FlushRetireQueue();
+
+	UPROPERTY()
+	UGeometryActorPool* ActorPool;
+
+	FDelegateHandle GeometryEventsHandle;
+
+	FGeometrySpatialHash SpatialIndex;
+
+	// Move types and colors of the shapes placed by DoActorSpawn
+	FGeometryRandomStream RandomStream;
+
+	// Open from BeginPlay until all its records have been spawned
+	TUniquePtr<FGeometryLayoutReader> Layout;
+
+	// Classes of the layout class table, null for the classes which couldn't be loaded
+	UPROPERTY()
+	TArray<TSubclassOf<ABaseGeometryActor>> LayoutClasses;
+
+	static constexpr int32 NumDemoActors = 20;
+
+	// The time-sliced spawning runs the demo shapes, then the pool prewarm, then the items
+	int32 NextDemoIndex = NumDemoActors;
+	// Classes still to prewarm and their remaining actor counts, one actor per step
+	TArray<TPair<TSubclassOf<ABaseGeometryActor>, int32>> PendingPrewarm;
+	// Next item of the time-sliced spawning (see GetNumSpawnItems), INDEX_NONE if nothing is pending
+	int32 NextPayloadIndex = INDEX_NONE;
+	TSharedPtr<FStreamableHandle> PayloadClassesHandle;
+
+	UPROPERTY(Replicated)
+	FGeometryReplicatedArray ReplicatedGeometry;
+
+	TMap<FIntPoint, FGeometryStreamingCell> StreamingCells;
+	// Only these are checked for release, only the cells around the pawns for loading
+	TArray<FIntPoint> LoadedCellKeys;
+	// Loaded cells with items left to spawn, oldest first
+	TArray<FIntPoint> PendingCellSpawns;
+	// Cell of every actor spawned by a loaded cell
+	TMap<TObjectKey<ABaseGeometryActor>, FIntPoint> StreamedActorCells;
+
+	// Deactivated actors waiting for destruction, oldest first from RetireQueueHead
+	UPROPERTY()
+	TArray<ABaseGeometryActor*> RetireQueue;
+	int32 RetireQueueHead = 0;
+	double LastRetireMs = 0.0;
+	double LastRetireSlowestActorMs = 0.0;
+
+	double BandwidthWindowStart = 0.0;
+	float ReplicationBytesPerSecond = 0.0f;
 };
@@ -0,0 +1,165 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "BaseGeometryActor.h"
+#include "GeometryInstanceRendererComponent.generated.h"
+
+class UInstancedStaticMeshComponent;
+
+/**
+ * @brief Identifies one instance drawn by UGeometryInstanceRendererComponent.
+ */
+USTRUCT()
+struct FGeometryInstanceHandle
+{
+	GENERATED_BODY()
+
+	// Index of the instance in the renderer, INDEX_NONE if the handle is not valid
+	int32 Index = INDEX_NONE;
+
+	bool IsValid() const { return Index != INDEX_NONE; }
+};
+
+/**
+ * @brief Draws geometry without actors: one UInstancedStaticMeshComponent per geometry class.
+ *
+ * The mesh and the materials are taken from the BaseMesh of the class defaults. The color of every instance lives
+ * in the per-instance custom data floats 0..3 (R, G, B, A), so the material must read them with PerInstanceCustomData
+ * instead of the "Color" vector parameter. Thousands of colored shapes become a handful of draw calls and changing
+ * a color allocates no objects.
+ *
+ * Sin movement and the color timer of ABaseGeometryActor are reproduced for the instances in one batch per frame.
+ * The transforms are kept here and reach each mesh once at the end of the tick, in one BatchUpdateInstancesTransforms over
+ * the changed range: only the instance data is sent to the render thread, the scene proxy is not rebuilt. A plain instanced
+ * mesh is used because a hierarchical one rebuilds its cluster tree whenever an instance moves.
+ * With bUseGPUMovement the Sin instances are not touched after AddInstance: amplitude and frequency go to the custom data
+ * floats 4 and 5 and the material moves the instance in its World Position Offset.
+ */
+UCLASS(ClassGroup=(Geometry), meta=(BlueprintSpawnableComponent))
+class CPP_TUTORIAL_API UGeometryInstanceRendererComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	// Number of the per-instance custom data floats used for the color
+	static constexpr int32 NumColorCustomData = 4;
+	// Custom data floats read by the World Position Offset in GPU movement mode
+	static constexpr int32 AmplitudeCustomDataIndex = NumColorCustomData;
+	static constexpr int32 FrequencyCustomDataIndex = NumColorCustomData + 1;
+
+	UGeometryInstanceRendererComponent();
+
+	virtual void BeginPlay() override;
+
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+	/**
+	 * @brief Adds an instance of the class mesh. Returns an invalid handle if the class has no mesh.
+	 * @param bSimulate if false, the instance is only drawn: its movement and color timer are driven by the caller
+	 */
+	FGeometryInstanceHandle AddInstance(TSubclassOf<ABaseGeometryActor> GeometryClass, const FTransform& Transform, const FGeometryData& Data,
+	                                    bool bSimulate = true);
+
+	/** @brief Writes the color into the custom data of the instance. */
+	void SetInstanceColor(FGeometryInstanceHandle Handle, const FLinearColor& Color);
+
+	/** @brief Moves the instance, the mesh is updated once at the end of the frame. */
+	void SetInstanceTransform(FGeometryInstanceHandle Handle, const FTransform& Transform);
+
+	/** @brief Hides the instance for good, the handles of the other instances stay valid. */
+	void RemoveInstance(FGeometryInstanceHandle Handle);
+
+	/**
+	 * @brief Batch forms of SetInstanceTransform, SetInstanceColor and RemoveInstance, element i of the values belongs to Handles[i].
+	 * Meant for callers which update many instances of one mesh at once, e.g. one Mass chunk: the mesh is looked up once per run of handles.
+	 */
+	void SetInstanceTransforms(TConstArrayView<FGeometryInstanceHandle> Handles, TConstArrayView<FTransform> Transforms);
+	void SetInstanceColors(TConstArrayView<FGeometryInstanceHandle> Handles, TConstArrayView<FLinearColor> Colors);
+	void RemoveInstances(TConstArrayView<FGeometryInstanceHandle> Handles);
+
+	/** @brief Location of the instance at the given world time, evaluated with the same formula as the material. */
+	FVector GetInstanceLocationAtTime(FGeometryInstanceHandle Handle, float Time) const;
+
+	/**
+	 * @brief Checks the custom data and the untouched transforms of every GPU-moved instance, works with -nullrhi.
+	 * @return false and the first problem in OutError if something doesn't match
+	 */
+	bool ValidateGPUMovement(FString& OutError) const;
+
+	int32 GetNumInstances() const { return InstanceMeshes.Num(); }
+	int32 GetNumMeshes() const { return Meshes.Num(); }
+
+	// If set, Sin instances are moved by the World Position Offset of the material: it must offset Z by
+	// PerInstanceCustomData[4] * sin(PerInstanceCustomData[5] * Time). Must be set before the first instance is added.
+	UPROPERTY(EditAnywhere, Category="Movement")
+	bool bUseGPUMovement = false;
+
+private:
+	int32 FindOrAddMesh(TSubclassOf<ABaseGeometryActor> GeometryClass);
+	void UpdateMovement(float Time);
+	void UpdateTimers(float Time);
+	void HideInstance(int32 Index);
+	void RemoveSinInstance(int32 Index);
+	// Pushes the changes of the frame to the meshes, one batch per mesh
+	void FlushMeshUpdates();
+
+	// Instance transforms of one mesh and what changed this frame
+	struct FMeshInstances
+	{
+		// World space, indexed by the instance index of the mesh
+		TArray<FTransform> Transforms;
+		// Changed transforms are within [DirtyBegin, DirtyEnd)
+		int32 DirtyBegin = MAX_int32;
+		int32 DirtyEnd = 0;
+		bool bCustomDataDirty = false;
+		// Bounds scale the GPU-moved instances need, applied once per frame: SetBoundsScale recomputes the bounds of all the instances
+		float RequiredBoundsScale = 1.0f;
+
+		void MarkTransformDirty(int32 InstanceIndex)
+		{
+			DirtyBegin = FMath::Min(DirtyBegin, InstanceIndex);
+			DirtyEnd = FMath::Max(DirtyEnd, InstanceIndex + 1);
+		}
+	};
+
+	UPROPERTY(Transient)
+	TArray<UInstancedStaticMeshComponent*> Meshes;
+
+	TMap<TSubclassOf<ABaseGeometryActor>, int32> MeshIndices;
+
+	// Parallel to Meshes
+	TArray<FMeshInstances> MeshInstances;
+
+	// Changed part of a transform array, reused every frame
+	TArray<FTransform> BatchTransforms;
+
+	// Per-instance data, element i of every array belongs to the instance with handle index i
+	TArray<int32> InstanceMeshes;
+	TArray<int32> InstanceIndices;
+	TArray<float> TimeRates;
+	TArray<float> NextFireTimes;
+	TArray<int32> TimerCounts;
+
+	// Timer colors of all the instances, seeded in BeginPlay from the run seed
+	FGeometryRandomStream ColorStream;
+
+	// Motion of every instance for the location queries, zero amplitude for static instances
+	TArray<FVector> InstanceLocations;
+	TArray<float> InstanceAmplitudes;
+	TArray<float> InstanceFrequencies;
+
+	// Sin movement, element j belongs to the instance SinInstances[j]. SinSlots[i] is the element of instance i, INDEX_NONE
+	// if it doesn't move on the CPU, so a finished instance is removed without a search.
+	TArray<int32> SinSlots;
+	TArray<int32> SinInstances;
+	TArray<FTransform> InitialTransforms;
+	TArray<float> Amplitudes;
+	TArray<float> Frequencies;
+	TArray<float> Offsets;
+
+	// Same as ABaseGeometryActor::MaxTimerCount
+	static constexpr int32 MaxTimerCount = 5;
+};
@@ -0,0 +1,145 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BaseGeometryActor.h"
+#include "GeometryPackedData.h"
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+/**
+ * Binary geometry layout, little endian:
+ *   FGeometryLayoutHeader
+ *   class table: NumClasses x (uint32 length + UTF-8 soft class path), padded to RecordAlignment
+ *   NumRecords x FGeometryLayoutRecord starting at RecordsOffset
+ */
+namespace GeometryLayout
+{
+	// The first four bytes of a layout file read "GYLT"
+	constexpr uint32 Magic = 0x544C5947;
+	// Bumped on every change of the header or the record layout, files of other versions are rejected
+	constexpr uint32 Version = 2;
+	constexpr uint32 RecordAlignment = 16;
+}
+
+struct FGeometryLayoutHeader
+{
+	uint32 Magic = GeometryLayout::Magic;
+	uint32 Version = GeometryLayout::Version;
+	// sizeof(FGeometryLayoutRecord) of the writer
+	uint32 RecordSize = 0;
+	uint32 NumClasses = 0;
+	uint32 NumRecords = 0;
+	uint32 RecordsOffset = 0;
+};
+
+/**
+ * @brief One geometry placement. Plain data, read in place from the mapped file.
+ * The geometry data is stored packed, see FPackedGeometryData for its precision.
+ */
+struct FGeometryLayoutRecord
+{
+	float Location[3];
+	// Rotation quaternion X, Y, Z, W
+	float Rotation[4];
+	float Scale[3];
+	FPackedGeometryData Data;
+	// Index into the class table
+	uint16 ClassIndex;
+	uint16 Padding;
+
+	FTransform GetTransform() const
+	{
+		return FTransform(FQuat(Rotation[0], Rotation[1], Rotation[2], Rotation[3]), FVector(Location[0], Location[1], Location[2]),
+		                  FVector(Scale[0], Scale[1], Scale[2]));
+	}
+
+	FGeometryData GetData() const
+	{
+		return Data.Unpack();
+	}
+
+	// The records are read in place and not validated on Open, check every record before it is used
+	bool IsValid(int32 NumClasses) const
+	{
+		return ClassIndex < NumClasses && Data.HasValidMoveType();
+	}
+
+	static FGeometryLayoutRecord Make(const FTransform& Transform, const FGeometryData& Data, uint16 ClassIndex);
+};
+
+static_assert(sizeof(FGeometryLayoutHeader) == 24, "Bump GeometryLayout::Version when the header changes");
+static_assert(sizeof(FGeometryLayoutRecord) == 56, "Bump GeometryLayout::Version when the record changes");
+
+/**
+ * @brief Memory-maps a layout file and gives direct access to its records.
+ *
+ * Only the class table is converted on Open, the records are not copied or parsed:
+ * GetRecord returns a reference into the mapped file. Platforms without memory mapping fall back to reading
+ * the whole file into memory once.
+ */
+class CPP_TUTORIAL_API FGeometryLayoutReader
+{
+public:
+	FGeometryLayoutReader();
+	~FGeometryLayoutReader();
+
+	FGeometryLayoutReader(const FGeometryLayoutReader&) = delete;
+	FGeometryLayoutReader& operator=(const FGeometryLayoutReader&) = delete;
+
+	/** @brief Maps the file and validates its header. Returns false and logs the reason if the file can't be used. */
+	bool Open(const FString& FilePath);
+	void Close();
+
+	bool IsOpen() const { return Records != nullptr; }
+
+	const TArray<FSoftObjectPath>& GetClassPaths() const { return ClassPaths; }
+
+	int32 Num() const { return NumRecords; }
+
+	const FGeometryLayoutRecord& GetRecord(int32 Index) const
+	{
+		check(Index >= 0 && Index < NumRecords);
+		return Records[Index];
+	}
+
+private:
+	bool Parse(const uint8* Data, int64 Size, const FString& FilePath);
+
+	TUniquePtr<IMappedFileHandle> MappedHandle;
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+	// Used when the platform can't map the file
+	TArray64<uint8> FallbackBuffer;
+
+	TArray<FSoftObjectPath> ClassPaths;
+	const FGeometryLayoutRecord* Records = nullptr;
+	int32 NumRecords = 0;
+};
+
+/** @brief Writes layout files, used by the tools and the geometry.Layout.Convert console command. */
+class CPP_TUTORIAL_API FGeometryLayoutWriter
+{
+public:
+	/** @brief Appends a record, the class is added to the class table on first use. */
+	void Add(const FSoftObjectPath& ClassPath, const FTransform& Transform, const FGeometryData& Data);
+
+	bool Save(const FString& FilePath) const;
+
+	int32 Num() const { return Records.Num(); }
+
+	/**
+	 * @brief Converts a payload export to a layout file.
+	 *
+	 * The source is a CSV file with a header row or a JSON array of objects, both with the fields
+	 * Class, X, Y, Z, Pitch, Yaw, Roll, ScaleX, ScaleY, ScaleZ, MoveType, Amplitude, Frequency, R, G, B, A, TimeRate.
+	 * Only Class is required, missing fields keep the FGeometryData and identity transform defaults.
+	 */
+	static bool Convert(const FString& SourcePath, const FString& TargetPath, FString& OutError);
+
+private:
+	TArray<FSoftObjectPath> ClassPaths;
+	TMap<FSoftObjectPath, uint16> ClassIndices;
+	TArray<FGeometryLayoutRecord> Records;
+};
@@ -0,0 +1,26 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Per-actor diagnostic output of the geometry classes (PrintTransform, timer and hub event logs).
+// With 0 these lines are compiled out together with the string building behind them.
+// Can be overridden from the Build.cs with PublicDefinitions.Add("GEOMETRY_DIAGNOSTIC_LOGGING=0").
+#ifndef GEOMETRY_DIAGNOSTIC_LOGGING
+#define GEOMETRY_DIAGNOSTIC_LOGGING !UE_BUILD_SHIPPING
+#endif
+
+// Compile-time verbosity of LogBaseGeometry and LogGeometryHub. The diagnostic lines are logged as Verbose,
+// so without GEOMETRY_DIAGNOSTIC_LOGGING only warnings and errors remain in the binary.
+#if GEOMETRY_DIAGNOSTIC_LOGGING
+#define GEOMETRY_LOG_COMPILE_VERBOSITY All
+#else
+#define GEOMETRY_LOG_COMPILE_VERBOSITY Warning
+#endif
+
+// Runtime default. The diagnostic lines are switched on per category with the console,
+// e.g. "log LogBaseGeometry Verbose" or "log LogGeometryHub Verbose".
+#define GEOMETRY_LOG_DEFAULT_VERBOSITY Log
+
+CPP_TUTORIAL_API DECLARE_LOG_CATEGORY_EXTERN(LogBaseGeometry, GEOMETRY_LOG_DEFAULT_VERBOSITY, GEOMETRY_LOG_COMPILE_VERBOSITY);
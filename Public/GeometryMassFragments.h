@@ -0,0 +1,74 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MassEntityTypes.h"
+#include "BaseGeometryActor.h"
+#include "GeometryInstanceRendererComponent.h"
+#include "GeometryRandom.h"
+#include "GeometryMassFragments.generated.h"
+
+// Sin movement parameters, InitialLocation plays the role of ABaseGeometryActor::Initiallocation
+USTRUCT()
+struct FGeometryMovementFragment : public FMassFragment
+{
+	GENERATED_BODY()
+
+	FVector InitialLocation = FVector::ZeroVector;
+	float Amplitude = 0.0f;
+	float Frequency = 0.0f;
+	EMovementType MoveType = EMovementType::Static;
+};
+
+USTRUCT()
+struct FGeometryColorFragment : public FMassFragment
+{
+	GENERATED_BODY()
+
+	FLinearColor Color = FLinearColor::Black;
+};
+
+// Same state as the color timer of ABaseGeometryActor
+USTRUCT()
+struct FGeometryTimerFragment : public FMassFragment
+{
+	GENERATED_BODY()
+
+	float TimeRate = 0.0f;
+	float NextFireTime = 0.0f;
+	int32 TimerCount = 0;
+
+	// Per entity, so the colors don't depend on the order in which the chunks are processed
+	FGeometryRandomStream ColorStream;
+};
+
+// The instance drawing the entity
+USTRUCT()
+struct FGeometryInstanceFragment : public FMassFragment
+{
+	GENERATED_BODY()
+
+	FGeometryInstanceHandle Instance;
+};
+
+// Shared by all the entities of one geometry class drawn by one renderer, so they end up in the same chunks
+USTRUCT()
+struct FGeometryClassSharedFragment : public FMassSharedFragment
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TWeakObjectPtr<UGeometryInstanceRendererComponent> Renderer;
+
+	// Class of the actor created when the entity is promoted
+	UPROPERTY()
+	TSubclassOf<ABaseGeometryActor> GeometryClass;
+};
+
+// Entities with Sin movement, the movement processor skips the others
+USTRUCT()
+struct FGeometrySinTag : public FMassTag
+{
+	GENERATED_BODY()
+};
@@ -0,0 +1,64 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MassEntityQuery.h"
+#include "MassProcessor.h"
+#include "GeometryInstanceRendererComponent.h"
+#include "GeometryMassProcessors.generated.h"
+
+/**
+ * @brief Sin movement of the geometry entities, one chunk at a time.
+ *
+ * The parameters of a chunk are gathered into contiguous arrays for GeometryKernels::ComputeSinOffsets,
+ * the results are written to the transform fragments and handed to the renderer in one call per chunk.
+ */
+UCLASS()
+class CPP_TUTORIAL_API UGeometrySinMovementProcessor : public UMassProcessor
+{
+	GENERATED_BODY()
+
+public:
+	UGeometrySinMovementProcessor();
+
+protected:
+	virtual void ConfigureQueries() override;
+	virtual void Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) override;
+
+private:
+	FMassEntityQuery EntityQuery;
+
+	// Scratch buffers of the current chunk
+	TArray<float> Amplitudes;
+	TArray<float> Frequencies;
+	TArray<float> Offsets;
+	TArray<FGeometryInstanceHandle> InstanceHandles;
+	TArray<FTransform> InstanceTransforms;
+};
+
+/**
+ * @brief Color timer of the geometry entities: a new random color every TimeRate seconds,
+ * the entity and its instance are removed after ABaseGeometryActor's MaxTimerCount colors.
+ * The renderer gets the color changes and the removals of a chunk in one call each.
+ */
+UCLASS()
+class CPP_TUTORIAL_API UGeometryColorCycleProcessor : public UMassProcessor
+{
+	GENERATED_BODY()
+
+public:
+	UGeometryColorCycleProcessor();
+
+protected:
+	virtual void ConfigureQueries() override;
+	virtual void Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) override;
+
+private:
+	FMassEntityQuery EntityQuery;
+
+	// Scratch buffers of the current chunk
+	TArray<FGeometryInstanceHandle> ColorHandles;
+	TArray<FLinearColor> NewColors;
+	TArray<FGeometryInstanceHandle> RemovedHandles;
+};
@@ -0,0 +1,51 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "MassEntityTypes.h"
+#include "MassEntityQuery.h"
+#include "BaseGeometryActor.h"
+#include "GeometryMassSubsystem.generated.h"
+
+class UGeometryInstanceRendererComponent;
+
+/**
+ * @brief Mass entity backend of the geometry: a shape is an entity with a handful of fragments instead of an actor.
+ *
+ * Entities are drawn as instances of a UGeometryInstanceRendererComponent and simulated by UGeometrySinMovementProcessor
+ * and UGeometryColorCycleProcessor. An actor is only created when gameplay asks for one with PromoteToActor.
+ * Needs the MassGameplay plugin to be enabled in the project.
+ */
+UCLASS()
+class CPP_TUTORIAL_API UGeometryMassSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	/** @brief Creates an entity drawn by Renderer. Returns an invalid handle if the class has no mesh. */
+	FMassEntityHandle SpawnEntity(UGeometryInstanceRendererComponent* Renderer, TSubclassOf<ABaseGeometryActor> GeometryClass, const FTransform& Transform,
+	                              const FGeometryData& Data);
+
+	/**
+	 * @brief Replaces the entity with an actor of its geometry class carrying its current data.
+	 * The Sin phase is kept, the color timer of the actor starts over. Must not be called while Mass processors run.
+	 */
+	ABaseGeometryActor* PromoteToActor(FMassEntityHandle Entity);
+
+	/** @brief Appends every geometry entity whose location is within Radius of Center. */
+	void CollectEntitiesInSphere(const FVector& Center, float Radius, TArray<FMassEntityHandle>& OutEntities);
+
+private:
+	FMassEntityQuery LocationQuery;
+
+	// One archetype with and one without FGeometrySinTag
+	FMassArchetypeHandle StaticArchetype;
+	FMassArchetypeHandle SinArchetype;
+
+	// Spawn order of the entities, the key of their random streams
+	uint64 NumSpawnedEntities = 0;
+};
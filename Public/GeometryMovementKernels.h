@@ -0,0 +1,54 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UWorld;
+
+/**
+ * @brief Batch kernels for the geometry movement math.
+ *
+ * All the functions work on packed arrays of movement parameters, element i of every array belongs to the same actor.
+ */
+namespace GeometryKernels
+{
+	// Maximum absolute difference between ComputeSinOffsets and FMath::Sin for a unit amplitude, for any Frequency * Time
+	constexpr float SinAccuracyBound = 1.0e-4f;
+	// The vector path reduces arguments up to this to [-PI, PI] itself, a register with a larger one uses FMath::Sin
+	constexpr float SinReductionRange = 65536.0f * UE_TWO_PI;
+	// ValidateSinKernel sweeps this range, past SinReductionRange so both paths are checked: weeks at Frequency 2
+	constexpr float SinValidationRange = 4.0e6f;
+
+	/**
+	 * @brief Amplitude * sin(Frequency * Time) for one shape.
+	 * This is the formula the World Position Offset of the GPU movement mode evaluates, use it wherever gameplay
+	 * needs the position of a shape that is not moved on the CPU.
+	 */
+	inline float EvaluateSinOffset(float Amplitude, float Frequency, float Time)
+	{
+		return Amplitude * FMath::Sin(Frequency * Time);
+	}
+
+	/**
+	 * @brief OutOffsets[i] = Amplitudes[i] * sin(Frequencies[i] * Time), evaluated 4 or 8 lanes at a time.
+	 * Falls back to ComputeSinOffsetsScalar when vector intrinsics are not available or disabled.
+	 */
+	CPP_TUTORIAL_API void ComputeSinOffsets(const float* Amplitudes, const float* Frequencies, float Time, float* OutOffsets, int32 Num);
+
+	/** @brief Reference implementation of ComputeSinOffsets built on FMath::Sin. */
+	CPP_TUTORIAL_API void ComputeSinOffsetsScalar(const float* Amplitudes, const float* Frequencies, float Time, float* OutOffsets, int32 Num);
+
+	/**
+	 * @brief Compares ComputeSinOffsets against FMath::Sin densely around 0 and sparsely over the validation range.
+	 * @param OutMaxError the largest absolute error that was found
+	 * @return true if the error stays within SinAccuracyBound
+	 */
+	CPP_TUTORIAL_API bool ValidateSinKernel(float& OutMaxError);
+
+	/**
+	 * @brief Time of the movement formulas: the server world time, so clients of a replicated hub evaluate the
+	 * same motion as the server without receiving any transform. Same as GetTimeSeconds on the server and in standalone.
+	 */
+	CPP_TUTORIAL_API float GetMovementTime(const UWorld* World);
+}
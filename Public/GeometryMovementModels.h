@@ -0,0 +1,117 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BaseGeometryActor.h"
+
+/**
+ * @brief A movement pattern of the geometry: offset from the initial location as a function of Amplitude, Frequency and time.
+ *
+ * Built from a model type with MakeMovementModel, which instantiates the batch loop for that type only: a group of actors
+ * with the same model is moved by one call of UpdateBatch, a loop without any branch on the movement type.
+ */
+struct FGeometryMovementModel
+{
+	using FEvaluateOffsetFunction = FVector (*)(float Amplitude, float Frequency, float Time);
+	using FUpdateBatchFunction = void (*)(const FVector* InitialLocations, const float* Amplitudes, const float* Frequencies, float Time,
+	                                      FVector* OutLocations, int32 Num);
+
+	const TCHAR* Name = nullptr;
+	FEvaluateOffsetFunction EvaluateOffset = nullptr;
+	FUpdateBatchFunction UpdateBatch = nullptr;
+
+	bool IsValid() const { return EvaluateOffset && UpdateBatch; }
+};
+
+namespace GeometryMovement
+{
+	// Number of EMovementType values, all of them fit into the move type bits of FPackedGeometryData
+	constexpr int32 MaxMovementTypes = 8;
+
+	/** @brief OutLocations[i] = InitialLocations[i] + TModel::EvaluateOffset(...), compiled once per model. */
+	template<typename TModel>
+	void UpdateBatch(const FVector* RESTRICT InitialLocations, const float* RESTRICT Amplitudes, const float* RESTRICT Frequencies, float Time,
+	                 FVector* RESTRICT OutLocations, int32 Num)
+	{
+		for (int32 i = 0; i < Num; ++i)
+		{
+			OutLocations[i] = InitialLocations[i] + TModel::EvaluateOffset(Amplitudes[i], Frequencies[i], Time);
+		}
+	}
+
+	/**
+	 * @brief Model of TModel, a type with a static FVector EvaluateOffset(float Amplitude, float Frequency, float Time).
+	 * The function is inlined into the batch loop.
+	 */
+	template<typename TModel>
+	FGeometryMovementModel MakeMovementModel(const TCHAR* Name)
+	{
+		FGeometryMovementModel Model;
+		Model.Name = Name;
+		Model.EvaluateOffset = &TModel::EvaluateOffset;
+		Model.UpdateBatch = &UpdateBatch<TModel>;
+		return Model;
+	}
+
+	/**
+	 * @brief Binds a model to a movement type. Game code binds its own models to EMovementType::Custom1..3, typically in
+	 * StartupModule, without touching ABaseGeometryActor.
+	 * Takes effect at once: the movement groups point at the registry slot, so actors already moving with a model of that type
+	 * switch to the new one at their next update. Actors started while the type had no model aren't in a group and don't join one.
+	 */
+	CPP_TUTORIAL_API void RegisterModel(EMovementType Type, const FGeometryMovementModel& Model);
+
+	template<typename TModel>
+	void RegisterModel(EMovementType Type, const TCHAR* Name)
+	{
+		RegisterModel(Type, MakeMovementModel<TModel>(Name));
+	}
+
+	/** @brief The model of the movement type, null for Static and for custom types without a model. */
+	CPP_TUTORIAL_API const FGeometryMovementModel* FindModel(EMovementType Type);
+
+	inline bool IsMoving(EMovementType Type)
+	{
+		return FindModel(Type) != nullptr;
+	}
+
+	// Built-in models
+
+	struct FSinModel
+	{
+		static FVector EvaluateOffset(float Amplitude, float Frequency, float Time)
+		{
+			return FVector(0.0f, 0.0f, Amplitude * FMath::Sin(Frequency * Time));
+		}
+	};
+
+	// Circle of radius Amplitude around the initial location in the XY plane
+	struct FOrbitModel
+	{
+		static FVector EvaluateOffset(float Amplitude, float Frequency, float Time)
+		{
+			float Sin, Cos;
+			FMath::SinCos(&Sin, &Cos, Frequency * Time);
+			return FVector(Amplitude * Cos, Amplitude * Sin, 0.0f);
+		}
+	};
+
+	// Hops of height Amplitude, Frequency / PI hops per second
+	struct FBounceModel
+	{
+		static FVector EvaluateOffset(float Amplitude, float Frequency, float Time)
+		{
+			return FVector(0.0f, 0.0f, Amplitude * FMath::Abs(FMath::Sin(Frequency * Time)));
+		}
+	};
+
+	// 3:2 Lissajous figure in the YZ plane
+	struct FLissajousModel
+	{
+		static FVector EvaluateOffset(float Amplitude, float Frequency, float Time)
+		{
+			return FVector(0.0f, Amplitude * FMath::Sin(3.0f * Frequency * Time), Amplitude * FMath::Sin(2.0f * Frequency * Time));
+		}
+	};
+}
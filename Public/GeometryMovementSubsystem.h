@@ -0,0 +1,231 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "GeometryMovementSubsystem.generated.h"
+
+class ABaseGeometryActor;
+struct FGeometryMovementModel;
+
+USTRUCT(BlueprintType)
+struct FGeometrySignificanceBucket
+{
+	GENERATED_BODY()
+
+	// Actors up to this distance from the player camera fall into the bucket
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Significance", meta=(ClampMin="0.0", Units="cm"))
+	float MaxDistance = 0.0f;
+
+	// Seconds between two full updates (sweep, overlaps, physics) of the actors in the bucket, 0 updates them fully every frame.
+	// In between, the actors still follow their movement every frame with a transform-only update.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Significance", meta=(ClampMin="0.0", Units="s"))
+	float UpdateInterval = 0.0f;
+};
+
+USTRUCT(BlueprintType)
+struct FGeometrySignificanceSettings
+{
+	GENERATED_BODY()
+
+	FGeometrySignificanceSettings();
+
+	// Sorted by MaxDistance, at most UGeometryMovementSubsystem::MaxSignificanceBuckets.
+	// Actors beyond the last bucket are frozen: no movement update and no tick.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Significance")
+	TArray<FGeometrySignificanceBucket> Buckets;
+
+	// Distance multiplier for actors outside the field of view of the camera
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Significance", meta=(ClampMin="1.0"))
+	float OutOfViewDistanceScale = 2.0f;
+
+	// Seconds between two evaluations of the buckets
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Significance", meta=(ClampMin="0.0", Units="s"))
+	float EvaluationInterval = 0.25f;
+
+	// Seconds over which an actor entering another bucket blends from its last location back onto the Sin curve
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Significance", meta=(ClampMin="0.0", Units="s"))
+	float BlendTime = 0.3f;
+};
+
+// Actors of one movement model other than Sin, moved by one call of the batch kernel of the model
+USTRUCT()
+struct FGeometryMovementGroup
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<ABaseGeometryActor*> Actors;
+
+	TArray<FVector> InitialLocations;
+	TArray<float> Amplitudes;
+	TArray<float> Frequencies;
+
+	// Significance state, see the Sin buffers of UGeometryMovementSubsystem
+	TArray<uint8> Buckets;
+	TArray<float> NextUpdateTimes;
+	TArray<float> BlendStartTimes;
+	TArray<FVector> BlendStartLocations;
+
+	// Output of the kernel
+	TArray<FVector> Locations;
+
+	const FGeometryMovementModel* Model = nullptr;
+};
+
+/**
+ * @brief Moves all registered Sin-mode geometry actors in one batch per frame.
+ *
+ * Instead of every ABaseGeometryActor ticking on its own, the movement parameters of the registered actors
+ * are kept in structure-of-arrays buffers, so the Z offsets for the whole world are computed in one tight loop.
+ * Registered actors switch their own PrimaryActorTick off.
+ *
+ * With geometry.Movement.FixedStepRate set, the Sin positions are simulated at that fixed rate instead of once per frame and
+ * the rendered positions are interpolated between the last two steps, so the simulation cost doesn't grow with the frame rate.
+ *
+ * Actors of the other movement models (see GeometryMovementModels.h) are grouped by model, the locations of a group are
+ * computed by one monomorphic loop of its model every frame and then committed through the same significance buckets.
+ *
+ * Every actor is also put into a significance bucket by its distance to the player camera. The actors of far buckets get
+ * their full update less often, but are moved along their curve every frame with a transform-only update, so they don't step.
+ * Actors beyond the last bucket are not moved at all. Actors which tick themselves (see RegisterTickingActor) get the tick
+ * interval of their bucket, and the subsystem moves them the same cheap way between their ticks.
+ */
+UCLASS()
+class CPP_TUTORIAL_API UGeometryMovementSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	void RegisterActor(ABaseGeometryActor* Actor);
+	void UnregisterActor(ABaseGeometryActor* Actor);
+
+	int32 GetNumRegistered() const { return Actors.Num(); }
+
+	/** @brief Adds an actor of a movement model other than Sin to the group of its model. */
+	void RegisterGroupActor(ABaseGeometryActor* Actor);
+	void UnregisterGroupActor(ABaseGeometryActor* Actor);
+
+	/** @brief Adds an actor which moves in its own Tick, only its tick rate is driven by the significance buckets. */
+	void RegisterTickingActor(ABaseGeometryActor* Actor);
+	void UnregisterTickingActor(ABaseGeometryActor* Actor);
+
+	static constexpr int32 MaxSignificanceBuckets = 4;
+
+	void SetSignificanceSettings(const FGeometrySignificanceSettings& InSettings);
+	const FGeometrySignificanceSettings& GetSignificanceSettings() const { return SignificanceSettings; }
+
+	/**
+	 * @brief Moves every registered actor to its position at the given time.
+	 * @param bParallel compute the locations with ParallelFor and commit them in bulk instead of one SetActorLocation per actor
+	 */
+	void UpdateMovement(float Time, bool bParallel);
+
+	/**
+	 * @brief Fixed-step variant of UpdateMovement: simulates the steps of StepRate Hz up to Time and moves the actors to
+	 * their location interpolated between the last two steps, one step behind the simulation.
+	 * Only the last two steps are simulated after a long frame, the Sin motion doesn't depend on the skipped ones.
+	 * The interpolated locations are always committed in bulk, bParallel only spreads their evaluation over the workers.
+	 */
+	void UpdateFixedStep(float Time, float StepRate, bool bParallel);
+
+	/** @brief The next UpdateFixedStep starts a new step sequence at its time. */
+	void ResetFixedStep() { FixedStepTime = -1.0f; }
+
+private:
+	struct FSignificanceView
+	{
+		bool bValid = false;
+		FVector Location = FVector::ZeroVector;
+		FVector Direction = FVector::ForwardVector;
+		float CosHalfFov = 0.0f;
+	};
+
+	void UpdateMovementParallel(float Time);
+	void SimulateStep(float StepTime);
+	void ApplyInterpolation(float Alpha, bool bParallel);
+	/**
+	 * @brief Moves the actors at Indices to NewLocations.
+	 * @param bBulk skip the sweep and overlap updates of SetActorLocation for every actor
+	 * @param FullUpdateMask if given, only the actors with their bit set get the SetActorLocation update
+	 */
+	void CommitLocations(const TArray<int32>& Indices, bool bBulk, const TBitArray<>* FullUpdateMask = nullptr);
+	void UpdateGroups(float Time, bool bParallel);
+	void UpdateSignificance(float Time);
+	// Every actor which isn't frozen goes into DueIndices, FullUpdates marks the ones whose bucket interval has elapsed
+	void CollectDueActors(float Time, bool bUseSignificance);
+	// Moves the throttled ticking actors along their curve between their ticks
+	void UpdateThrottledTickingActors(float Time);
+	uint8 ComputeBucket(const FSignificanceView& View, const FVector& Location) const;
+	// Negative if the bucket is frozen
+	float GetUpdateInterval(uint8 Bucket) const;
+	// Time of the next full update of the actor at Index after one at Time
+	static float GetNextUpdateTime(int32 Index, float Time, float Interval);
+
+	// Z of the actor for the given Sin offset, blended while the actor settles into a new bucket
+	float ResolveZ(int32 Index, float Offset, float Time)
+	{
+		float Z = InitialLocations[Index].Z + Offset;
+		if (SignificanceSettings.BlendTime > 0.0f)
+		{
+			const float BlendAlpha = (Time - BlendStartTimes[Index]) / SignificanceSettings.BlendTime;
+			if (BlendAlpha >= 0.0f && BlendAlpha < 1.0f)
+			{
+				Z = FMath::Lerp(BlendStartZ[Index], Z, FMath::SmoothStep(0.0f, 1.0f, BlendAlpha));
+			}
+		}
+		LastZ[Index] = Z;
+		return Z;
+	}
+
+	// Structure-of-arrays buffers: element i of every array belongs to the same actor.
+	// Removal is done with RemoveAtSwap, so the actor keeps its current index in MovementIndex.
+	UPROPERTY()
+	TArray<ABaseGeometryActor*> Actors;
+
+	TArray<FVector> InitialLocations;
+	TArray<float> Amplitudes;
+	TArray<float> Frequencies;
+
+	// Significance state, part of the same structure-of-arrays
+	TArray<uint8> Buckets;
+	TArray<float> NextUpdateTimes;
+	TArray<float> LastZ;
+	TArray<float> BlendStartTimes;
+	TArray<float> BlendStartZ;
+
+	// Z of the step before the last one, LastZ holds the last step in fixed-step mode
+	TArray<float> PrevZ;
+
+	// Indexed by EMovementType, so the groups of the models are never reordered
+	UPROPERTY()
+	TArray<FGeometryMovementGroup> Groups;
+
+	// Actors moving in their own Tick and their buckets, indexed by ABaseGeometryActor::TickingIndex
+	UPROPERTY()
+	TArray<ABaseGeometryActor*> TickingActors;
+	TArray<uint8> TickingBuckets;
+
+	FGeometrySignificanceSettings SignificanceSettings;
+	float NextSignificanceTime = 0.0f;
+
+	// Scratch buffers of the current frame: the actors moved this frame, their parameters, Z offsets and new locations
+	TArray<int32> DueIndices;
+	TBitArray<> FullUpdates;
+	TArray<float> DueAmplitudes;
+	TArray<float> DueFrequencies;
+	TArray<float> Offsets;
+	TArray<FVector> NewLocations;
+
+	// Fixed-step state: time and length of the last simulated step and the actors it updated.
+	// The indices are not patched by UnregisterActor, an index moved by RemoveAtSwap interpolates the actor now in that slot.
+	float FixedStepTime = -1.0f;
+	float FixedStepLength = 0.0f;
+	TArray<int32> StepIndices;
+};
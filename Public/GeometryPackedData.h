@@ -0,0 +1,88 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Math/Float16.h"
+#include "BaseGeometryActor.h"
+#include "GeometryPackedData.generated.h"
+
+class UPackageMap;
+
+/**
+ * @brief Runtime form of FGeometryData for bulk storage and replication, 12 bytes instead of 32.
+ *
+ * Color is 8 bit per channel linear (not sRGB) and clamped to [0, 1], Amplitude, Frequency and TimeRate are half floats
+ * (11 significant bits, clamped to +-65504), MoveType takes the low bits of Flags.
+ * Packing is idempotent: data that went through Pack/Unpack once round-trips without any loss.
+ */
+USTRUCT()
+struct CPP_TUTORIAL_API FPackedGeometryData
+{
+	GENERATED_BODY()
+
+	// EMovementType values up to 7, the remaining bits of Flags are reserved
+	static constexpr uint32 MoveTypeBits = 3;
+	static constexpr uint8 MoveTypeMask = (1 << MoveTypeBits) - 1;
+
+	FPackedGeometryData() = default;
+	explicit FPackedGeometryData(const FGeometryData& Data) { Pack(Data); }
+
+	void Pack(const FGeometryData& Data);
+	FGeometryData Unpack() const;
+
+	EMovementType GetMoveType() const { return static_cast<EMovementType>(Flags & MoveTypeMask); }
+
+	// False for reserved flag bits or a move type past the last EMovementType, e.g. in a corrupt layout record
+	bool HasValidMoveType() const { return Flags <= static_cast<uint8>(EMovementType::Custom3); }
+
+	/** @brief The value the editor-facing data has after a round trip through the packed form. */
+	static FGeometryData Quantize(const FGeometryData& Data) { return FPackedGeometryData(Data).Unpack(); }
+
+	/** @brief Writes the 80 bits of values and MoveTypeBits of flags. */
+	bool NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess);
+
+	bool operator==(const FPackedGeometryData& Other) const
+	{
+		return Color == Other.Color && Amplitude.Encoded == Other.Amplitude.Encoded && Frequency.Encoded == Other.Frequency.Encoded &&
+			TimeRate.Encoded == Other.TimeRate.Encoded && Flags == Other.Flags;
+	}
+
+	bool operator!=(const FPackedGeometryData& Other) const { return !(*this == Other); }
+
+	FColor Color = FColor::Black;
+	FFloat16 Amplitude;
+	FFloat16 Frequency;
+	FFloat16 TimeRate;
+	uint8 Flags = 0;
+};
+
+static_assert(sizeof(FPackedGeometryData) == 12, "FPackedGeometryData is meant to stay 12 bytes");
+
+template<>
+struct TStructOpsTypeTraits<FPackedGeometryData> : public TStructOpsTypeTraitsBase2<FPackedGeometryData>
+{
+	enum
+	{
+		WithNetSerializer = true,
+		WithIdenticalViaEquality = true,
+	};
+};
+
+namespace GeometryPacking
+{
+	/**
+	 * @brief Round-trip check of the packed form on NumSamples random values plus the defaults and the range limits.
+	 * Returns false and the first failing sample in OutError.
+	 */
+	CPP_TUTORIAL_API bool ValidateRoundTrip(int32 NumSamples, FString& OutError);
+
+	/** @brief Bits NetSerialize writes for Data. */
+	CPP_TUTORIAL_API int64 GetNetSerializedBits(const FPackedGeometryData& Data);
+
+	/**
+	 * @brief Bytes of the editor-only properties of Struct and its parents in this build.
+	 * Always 0 in cooked builds, where the WITH_EDITORONLY_DATA fields don't exist.
+	 */
+	CPP_TUTORIAL_API int32 GetEditorOnlyBytes(const UStruct* Struct);
+}
@@ -0,0 +1,82 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * @brief PCG32 random number stream (pcg-random.org).
+ *
+ * 16 bytes of state and no locks: every actor, renderer or worker owns its own stream instead of sharing the global
+ * FMath::Rand state. Two streams created with the same seed and stream id produce the same sequence on every platform.
+ */
+struct FGeometryRandomStream
+{
+	FGeometryRandomStream() : FGeometryRandomStream(0)
+	{
+	}
+
+	/**
+	 * @param Seed starting point of the sequence
+	 * @param StreamId selects one of 2^63 independent sequences for the same seed
+	 */
+	explicit FGeometryRandomStream(uint64 Seed, uint64 StreamId = 0)
+	{
+		Initialize(Seed, StreamId);
+	}
+
+	void Initialize(uint64 Seed, uint64 StreamId = 0)
+	{
+		State = 0;
+		Increment = (StreamId << 1) | 1;
+		NextUInt();
+		State += Seed;
+		NextUInt();
+	}
+
+	uint32 NextUInt()
+	{
+		const uint64 OldState = State;
+		State = OldState * 6364136223846793005ULL + Increment;
+		const uint32 XorShifted = static_cast<uint32>(((OldState >> 18) ^ OldState) >> 27);
+		const uint32 Rotation = static_cast<uint32>(OldState >> 59);
+		return (XorShifted >> Rotation) | (XorShifted << ((0u - Rotation) & 31));
+	}
+
+	/** @brief Uniform in [0, 1). */
+	float NextFloat()
+	{
+		return (NextUInt() >> 8) * (1.0f / 16777216.0f);
+	}
+
+	bool NextBool()
+	{
+		return (NextUInt() & 0x80000000u) != 0;
+	}
+
+	/** @brief A fully saturated color of random hue, the same distribution as FLinearColor::MakeRandomColor. */
+	FLinearColor NextColor()
+	{
+		return FLinearColor::MakeFromHSV8(static_cast<uint8>(NextUInt() >> 24), 255, 255);
+	}
+
+private:
+	uint64 State;
+	uint64 Increment;
+};
+
+namespace GeometryRandom
+{
+	/** @brief Seed of the whole run, set with geometry.Random.Seed. */
+	CPP_TUTORIAL_API uint64 GetSeed();
+
+	/** @brief A stream of the run seed, Key picks the sequence (e.g. a hash of the owner). */
+	CPP_TUTORIAL_API FGeometryRandomStream MakeStream(uint64 Key);
+
+	/**
+	 * @brief Fills OutColors with random colors on worker threads.
+	 * The array is split into fixed-size chunks with one stream per chunk, so the result only depends on Seed,
+	 * not on the number of workers or the order in which they run.
+	 */
+	CPP_TUTORIAL_API void FillRandomColors(uint64 Seed, TArrayView<FLinearColor> OutColors);
+}
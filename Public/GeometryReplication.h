@@ -0,0 +1,101 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/NetSerialization.h"
+#include "Net/Serialization/FastArraySerializer.h"
+#include "BaseGeometryActor.h"
+#include "GeometryPackedData.h"
+#include "GeometryReplication.generated.h"
+
+class AGeometryHubActor;
+struct FGeometryReplicatedArray;
+
+/**
+ * @brief One shape replicated by AGeometryHubActor: everything a client needs to spawn its own copy.
+ * The motion is never sent, the client evaluates it around the initial transform from the server time.
+ */
+USTRUCT()
+struct FGeometryReplicatedItem : public FFastArraySerializerItem
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TSubclassOf<ABaseGeometryActor> GeometryClass;
+
+	// Initial transform of the shape
+	UPROPERTY()
+	FVector_NetQuantize10 Location;
+
+	UPROPERTY()
+	FRotator Rotation = FRotator::ZeroRotator;
+
+	UPROPERTY()
+	FVector_NetQuantize100 Scale = FVector::OneVector;
+
+	UPROPERTY()
+	FPackedGeometryData Data;
+
+	// The actor on the server, its client copy on a client
+	UPROPERTY(NotReplicated)
+	TWeakObjectPtr<ABaseGeometryActor> Actor;
+
+	// Server: the key of the item in ItemIndices, still valid once the actor is gone
+	TObjectKey<ABaseGeometryActor> ActorKey;
+
+	FTransform GetTransform() const { return FTransform(Rotation, Location, Scale); }
+
+	void PostReplicatedAdd(const FGeometryReplicatedArray& Array);
+	void PostReplicatedChange(const FGeometryReplicatedArray& Array);
+	void PreReplicatedRemove(const FGeometryReplicatedArray& Array);
+};
+
+/**
+ * @brief The replicated shapes of a hub. Only items added, removed or changed since the last update are sent:
+ * after the initial burst only the color changes of the server timers go over the network.
+ */
+USTRUCT()
+struct CPP_TUTORIAL_API FGeometryReplicatedArray : public FFastArraySerializer
+{
+	GENERATED_BODY()
+
+	/** @brief Server: replicates the shape of Geometry with its current transform and data. */
+	void Add(ABaseGeometryActor* Geometry);
+
+	/** @brief Server: sends a new color, nothing is sent if the packed color doesn't change. */
+	void SetColor(ABaseGeometryActor* Geometry, const FLinearColor& Color);
+	/** @brief Same with a color already packed by FLinearColor::QuantizeRound, as in FGeometryEvent. */
+	void SetColor(ABaseGeometryActor* Geometry, const FColor& PackedColor);
+
+	/** @brief Server: the clients destroy their copy of the shape. */
+	void Remove(ABaseGeometryActor* Geometry);
+
+	int32 Num() const { return Items.Num(); }
+
+	/** @brief Bits written (server) or read (client) by NetDeltaSerialize since the last call. */
+	uint64 ConsumeNumSerializedBits();
+
+	bool NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms);
+
+	// Receives the client callbacks of the items, set by the hub
+	AGeometryHubActor* Owner = nullptr;
+
+private:
+	UPROPERTY()
+	TArray<FGeometryReplicatedItem> Items;
+
+	// Server: item of each replicated actor
+	TMap<TObjectKey<ABaseGeometryActor>, int32> ItemIndices;
+
+	uint64 NumSerializedBits = 0;
+};
+
+template<>
+struct TStructOpsTypeTraits<FGeometryReplicatedArray> : public TStructOpsTypeTraitsBase2<FGeometryReplicatedArray>
+{
+	enum
+	{
+		WithNetDeltaSerializer = true,
+	};
+};
@@ -0,0 +1,85 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class ABaseGeometryActor;
+
+/**
+ * @brief Uniform grid over geometry actors for sphere and box queries.
+ *
+ * Every actor lives in the cell of its last known location. Moving actors are refreshed incrementally:
+ * the stored location is overwritten and the actor only changes cells when it crosses a cell border.
+ * A query visits just the cells overlapped by its bounds, so its cost depends on the local density, not on the
+ * number of actors in the world.
+ */
+class CPP_TUTORIAL_API FGeometrySpatialHash
+{
+public:
+	explicit FGeometrySpatialHash(float InCellSize = 1000.0f);
+
+	/** @brief Changes the cell size and rebuilds the grid. */
+	void SetCellSize(float InCellSize);
+	float GetCellSize() const { return CellSize; }
+
+	/**
+	 * @brief Adds the actor at its current location.
+	 * @param bMoving the actor is refreshed by RefreshMovingEntries
+	 */
+	void Add(ABaseGeometryActor* Actor, bool bMoving);
+	void Remove(const ABaseGeometryActor* Actor);
+	void Reset();
+
+	/**
+	 * @brief Re-reads the location of every moving actor and drops the moving actors which are no longer valid,
+	 * as well as the static ones a query has found invalid since the last refresh.
+	 */
+	void RefreshMovingEntries();
+
+	// The queries are instantiated for TArray and TGeometryFrameArray results
+
+	/** @brief Appends every actor whose location is within Radius of Center. */
+	template <typename AllocatorType>
+	void QuerySphere(const FVector& Center, float Radius, TArray<ABaseGeometryActor*, AllocatorType>& OutActors) const;
+
+	/** @brief Appends every actor whose location is inside Box. */
+	template <typename AllocatorType>
+	void QueryBox(const FBox& Box, TArray<ABaseGeometryActor*, AllocatorType>& OutActors) const;
+
+	int32 Num() const { return Entries.Num(); }
+	bool Contains(const ABaseGeometryActor* Actor) const { return EntryByActor.Contains(Actor); }
+
+private:
+	struct FEntry
+	{
+		TWeakObjectPtr<ABaseGeometryActor> Actor;
+		// Key in EntryByActor, still usable after the actor has been garbage collected
+		const ABaseGeometryActor* ActorKey = nullptr;
+		FVector Location;
+		FIntVector Cell;
+		// Position of the entry in its cell array
+		int32 IndexInCell = INDEX_NONE;
+		bool bMoving = false;
+	};
+
+	FIntVector ToCell(const FVector& Location) const;
+	void AddToCell(int32 EntryIndex);
+	void RemoveFromCell(int32 EntryIndex);
+	void RemoveEntry(int32 EntryIndex);
+
+	template <typename PredicateType, typename AllocatorType>
+	void QueryCells(const FBox& Bounds, PredicateType Predicate, TArray<ABaseGeometryActor*, AllocatorType>& OutActors) const;
+
+	float CellSize;
+
+	// Dense entry storage, removal swaps the last entry in
+	TArray<FEntry> Entries;
+	TMap<const ABaseGeometryActor*, int32> EntryByActor;
+
+	// Entry indices per cell. A cell is kept once it is empty, an actor moving back into it doesn't allocate again.
+	TMap<FIntVector, TArray<int32>> Cells;
+
+	// Static entries are never refreshed, the queries note the invalid ones they come across for the next RefreshMovingEntries
+	mutable TArray<const ABaseGeometryActor*> StaleActorKeys;
+};
@@ -0,0 +1,46 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+
+// "stat GeometryActors" shows everything declared in this group
+DECLARE_STATS_GROUP(TEXT("Geometry Actors"), STATGROUP_GeometryActors, STATCAT_Advanced);
+
+// Per-frame counters
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Delegate Broadcasts"), STAT_GeometryDelegateBroadcasts, STATGROUP_GeometryActors, CPP_TUTORIAL_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Queued Events"), STAT_GeometryQueuedEvents, STATGROUP_GeometryActors, CPP_TUTORIAL_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("MID Allocations"), STAT_GeometryMIDAllocations, STATGROUP_GeometryActors, CPP_TUTORIAL_API);
+// Values kept between frames
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Live Sin Actors"), STAT_GeometryLiveSinActors, STATGROUP_GeometryActors, CPP_TUTORIAL_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Live Static Actors"), STAT_GeometryLiveStaticActors, STATGROUP_GeometryActors, CPP_TUTORIAL_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Live Orbit Actors"), STAT_GeometryLiveOrbitActors, STATGROUP_GeometryActors, CPP_TUTORIAL_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Live Bounce Actors"), STAT_GeometryLiveBounceActors, STATGROUP_GeometryActors, CPP_TUTORIAL_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Live Lissajous Actors"), STAT_GeometryLiveLissajousActors, STATGROUP_GeometryActors, CPP_TUTORIAL_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Live Custom 1 Actors"), STAT_GeometryLiveCustom1Actors, STATGROUP_GeometryActors, CPP_TUTORIAL_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Live Custom 2 Actors"), STAT_GeometryLiveCustom2Actors, STATGROUP_GeometryActors, CPP_TUTORIAL_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Live Custom 3 Actors"), STAT_GeometryLiveCustom3Actors, STATGROUP_GeometryActors, CPP_TUTORIAL_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("MID Allocations Total"), STAT_GeometryMIDAllocationsTotal, STATGROUP_GeometryActors, CPP_TUTORIAL_API);
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Last GC Pause (ms)"), STAT_GeometryLastGCPauseMs, STATGROUP_GeometryActors, CPP_TUTORIAL_API);
+
+/**
+ * @brief Game thread time of every garbage collection, from the pre to the post collect delegate.
+ * Reported by geometry.GC.Report, e.g. to compare a wave of finished geometry with and without deferred retirement.
+ */
+namespace GeometryGC
+{
+	struct FPauseStats
+	{
+		int32 NumCollections = 0;
+		double TotalMs = 0.0;
+		double MaxMs = 0.0;
+		double LastMs = 0.0;
+	};
+
+	/** @brief Binds the garbage collection delegates, later calls do nothing. */
+	CPP_TUTORIAL_API void StartTracking();
+
+	CPP_TUTORIAL_API const FPauseStats& GetPauseStats();
+	CPP_TUTORIAL_API void ResetPauseStats();
+}
@@ -0,0 +1,57 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "GeometryTimerSubsystem.generated.h"
+
+class ABaseGeometryActor;
+
+/**
+ * @brief Runs the color timers of the geometry actors grouped by TimeRate.
+ *
+ * Every distinct TimeRate (quantized to the wheel resolution) gets a bucket, all the actors of a bucket fire together
+ * in one batch. The buckets are dense arrays and every actor remembers its slot, so insert and cancel are O(1).
+ * A newly inserted actor joins the phase of its bucket: the first fire comes within one TimeRate.
+ */
+UCLASS()
+class CPP_TUTORIAL_API UGeometryTimerSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	// Granularity of the TimeRate quantization in seconds
+	static constexpr float Resolution = 0.01f;
+
+	virtual void Deinitialize() override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	void AddTimer(ABaseGeometryActor* Actor, float TimeRate);
+	void CancelTimer(ABaseGeometryActor* Actor);
+
+	int32 GetNumTimers() const { return NumTimers; }
+	int32 GetNumBuckets() const { return Buckets.Num(); }
+
+private:
+	struct FBucket
+	{
+		// The period of the bucket in resolution ticks
+		int32 RateTicks = 0;
+		float Period = 0.0f;
+		double NextFireTime = 0.0;
+		TArray<ABaseGeometryActor*> Actors;
+	};
+
+	void FireBucket(int32 BucketIndex);
+
+	// Buckets are never removed while the world lives, so the bucket index stored in the actors stays valid
+	TArray<FBucket> Buckets;
+	TMap<int32, int32> BucketByRate;
+
+	// Copy of the bucket being fired, kept to reuse its memory
+	TArray<ABaseGeometryActor*> FiringActors;
+
+	int32 NumTimers = 0;
+};
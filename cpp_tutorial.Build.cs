@@ -8,6 +8,15 @@ public class cpp_tutorial : ModuleRules
 	{
 		PCHUsage = PCHUsageMode.UseExplicitOrSharedPCHs;
 
-		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore", "EnhancedInput" });
+		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore", "EnhancedInput", "NetCore" });
+
+		// MassEntity and MassCommon: Mass entity backend of the geometry, needs the MassGameplay plugin
+		PrivateDependencyModuleNames.AddRange(new string[] { "Json", "MassEntity", "MassCommon" });
+
+		// UnrealEd: the replication test plays the map as a listen server with a client
+		if (Target.bBuildEditor)
+		{
+			PrivateDependencyModuleNames.Add("UnrealEd");
+		}
 	}
 }